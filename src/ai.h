@@ -6,6 +6,33 @@
 #define AI_H
 
 // ============================= ai commands ================================
+pair<position, Unit *> GetAction(const Unit &unit, const Tilemap &map);
+
+// How many simulation steps the enemy phase gets per frame.
+int
+PhaseSpeedSteps(PhaseSpeed speed)
+{
+    switch(speed)
+    {
+        case PHASE_SPEED_1X:      return 1;
+        case PHASE_SPEED_2X:      return 2;
+        case PHASE_SPEED_4X:      return 4;
+        case PHASE_SPEED_8X:      return 8;
+        case PHASE_SPEED_INSTANT: return 1; // Resolved all at once by AI.Update().
+        default: SDL_assert(!"ERROR Unhandled enum in PhaseSpeedSteps"); return 1;
+    }
+}
+
+// How long a unit has to think between being selected and acting, at the
+// current phase speed. Instant resolution does both at once.
+double
+ThinkingWindowMs()
+{
+    if(GlobalPhaseSpeed == PHASE_SPEED_INSTANT)
+        return 0.0;
+    return AI_ACTION_SPEED * 1000.0 / (SIM_TICK_RATE * PhaseSpeedSteps(GlobalPhaseSpeed));
+}
+
 class AIFindNextUnitCommand : public Command
 {
 public:
@@ -46,9 +73,11 @@ private:
 class AISelectUnitCommand : public Command
 {
 public:
-    AISelectUnitCommand(Cursor *cursor_in, Tilemap *map_in)
+    AISelectUnitCommand(Cursor *cursor_in, Tilemap *map_in,
+                        RolloutPlanner *planner_in)
     : cursor(cursor_in),
-      map(map_in)
+      map(map_in),
+      planner(planner_in)
     {}
 
     virtual void Execute()
@@ -56,10 +85,13 @@ public:
         cursor->selected = map->tiles[cursor->pos.col][cursor->pos.row].occupant;
         cursor->redo = cursor->pos;
 
+        GlobalAIProfiler.BeginDecision(cursor->selected->name, cursor->selected->turns_active);
+        ProfileScope profile(PROFILE_OTHER);
+
         map->accessible.clear();
         map->vis_range.clear();
         pair<vector<position>, vector<position>> result = 
-            AccessibleAndAttackableFrom(*map, cursor->redo,
+            CachedAccessibleAndAttackableFrom(*map, cursor->redo,
                                         cursor->selected->movement,
                                         cursor->selected->MinRange(),
                                         cursor->selected->MaxRange(),
@@ -68,17 +100,26 @@ public:
         map->vis_range = result.second;
 
         map->double_range = 
-            AccessibleAndAttackableFrom(*map, cursor->redo,
+            CachedAccessibleAndAttackableFrom(*map, cursor->redo,
                                         cursor->selected->movement * 2,
                                         cursor->selected->MinRange(),
                                         cursor->selected->MaxRange(),
                                         cursor->selected->is_ally).first;
 
+        // Start thinking now, so the answer is ready by the time we act.
+        if(GlobalAIMode == AI_MODE_ROLLOUT)
+        {
+            pair<position, Unit *> greedy = GetAction(*cursor->selected, *map);
+            ProfileScope rollout(PROFILE_ROLLOUT);
+            planner->Begin(*cursor->selected, *map, greedy, ThinkingWindowMs());
+        }
+
         GlobalAIState = SELECTED;
     }
 private:
     Cursor *cursor;
     Tilemap *map;
+    RolloutPlanner *planner;
 };
 
 
@@ -91,9 +132,7 @@ public:
 
     virtual void Execute()
     {
-        cursor->selected->is_exhausted = true;
-
-        cursor->selected->sheet.ChangeTrack(TRACK_IDLE);
+        cursor->selected->Deactivate();
         cursor->selected = nullptr;
 
         cursor->redo = {-1, -1};
@@ -105,6 +144,94 @@ private:
 };
 
 // =============================== Specification of Behaviors ==================
+// Where to stop on the way to the nearest opponent. Every square in reach is
+// weighed by how much closer it gets, and by what the influence maps say
+// about standing there: cover, nearby healers, and who could hit back.
+// Expects map.accessible to have been filled in for the unit.
+position
+ApproachSquare(const Unit &unit, const Tilemap &map)
+{
+    Unit *nearest = FindNearest(map, unit.pos,
+        [&unit](const Unit &other) -> bool
+        {
+            return other.is_ally != unit.is_ally;
+        }, unit.is_ally);
+    if(!nearest) // Nobody left to chase.
+        return unit.pos;
+
+    vector<vector<int>> distances;
+    GetField(map, nearest->pos, unit.is_ally, &distances);
+    if(distances[unit.pos.col][unit.pos.row] >= 100) // Walled off.
+        return unit.pos;
+
+    GlobalInfluence.Refresh(map);
+    ProfileScope profile(PROFILE_SCORING);
+    GlobalAIProfiler.CountCandidates((int)map.accessible.size());
+    position best = unit.pos;
+    int best_score = GlobalInfluence.Score(unit, unit.pos) -
+                     INFLUENCE_CHASE_WEIGHT * distances[unit.pos.col][unit.pos.row];
+    for(const position &p : map.accessible)
+    {
+        if(distances[p.col][p.row] >= 100)
+            continue;
+        int score = GlobalInfluence.Score(unit, p) -
+                    INFLUENCE_CHASE_WEIGHT * distances[p.col][p.row];
+        if(score > best_score)
+        {
+            best = p;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+// Of all the ways the unit could attack, the one expected to leave its target
+// the weakest. Ties go to the better square by the influence maps.
+pair<position, Unit *>
+WeakestTarget(const Unit &unit, const Tilemap &map,
+              const vector<pair<position, Unit *>> &possibilities)
+{
+    GlobalInfluence.Refresh(map);
+    ProfileScope profile(PROFILE_SCORING);
+    GlobalAIProfiler.CountCandidates((int)possibilities.size());
+
+    // Predict every matchup in one go.
+    static thread_local CombatBatch batch;
+    static thread_local OutcomeBatch outcomes;
+    batch.Clear();
+    CombatantStats attacker = CombatantStats::From(unit);
+    for(const pair<position, Unit *> &poss : possibilities)
+    {
+        const position &p = poss.first;
+        const Unit &target = *poss.second;
+        batch.Add(attacker, CombatantStats::From(target), ManhattanDistance(p, target.pos),
+                  map.tiles[p.col][p.row].avoid,
+                  map.tiles[target.pos.col][target.pos.row].avoid,
+                  map.tiles[p.col][p.row].defense,
+                  map.tiles[target.pos.col][target.pos.row].defense);
+    }
+    PredictCombatBatch(batch, &outcomes);
+
+    pair<position, Unit *> action = {unit.pos, NULL};
+    double min_health_after_attack = 999;
+    int best_score = 0;
+    for(int i = 0; i < possibilities.size(); ++i)
+    {
+        const pair<position, Unit *> &poss = possibilities[i];
+        // What the target is expected to be left with, over every way it could go.
+        double health_remaining = DistributeFight(outcomes.Get(i), unit.health, poss.second->health).two_health;
+        int score = GlobalInfluence.Score(unit, poss.first);
+        if(health_remaining < min_health_after_attack ||
+           (health_remaining == min_health_after_attack && score > best_score))
+        {
+            action = poss;
+            min_health_after_attack = health_remaining;
+            best_score = score;
+        }
+    }
+    return action;
+}
+
 pair<position, Unit *>
 PursueBehavior(const Unit &unit, const Tilemap &map)
 {
@@ -112,48 +239,11 @@ PursueBehavior(const Unit &unit, const Tilemap &map)
     vector<pair<position, Unit *>> possibilities = FindAttackingSquares(map, unit, map.accessible);
     if(possibilities.size() == 0) // No enemies to attack in range.
     {
-        Unit *nearest = FindNearest(map, unit.pos,
-            [](const Unit &unit) -> bool
-            {
-                return unit.is_ally;
-            }, false);
-        path path_to_nearest = GetPath(map, unit.pos, nearest->pos, false);
-        if(path_to_nearest.size())
-        {
-            position furthest = FurthestMovementOnPath(map, path_to_nearest, unit.movement);
-            if(furthest == position(0, 0))
-            {
-                furthest = unit.pos;
-            }
-            action = pair<position, Unit *>(furthest, NULL);
-        }
-        else
-            action = {unit.pos, NULL};
+        action = {ApproachSquare(unit, map), NULL};
     }
     else
     {
-        int min_health_after_attack = 999;
-        Outcome outcome;
-        //int max_odds = 0;
-        //int min_counter_dmg = 100;
-        //int min_counter_odds = 100;
-        for(const pair<position, Unit *> &poss : possibilities)
-        {
-            const position &p = poss.first;
-            Unit *target = poss.second;
-            outcome = PredictCombat(unit, *target,
-                                    ManhattanDistance(p, target->pos),
-                                    map.tiles[p.col][p.row].avoid,
-                                    map.tiles[target->pos.col][target->pos.row].avoid,
-                                    map.tiles[p.col][p.row].defense,
-                                    map.tiles[target->pos.col][target->pos.row].defense);
-            int health_remaining = clamp(target->health - outcome.two_damage * (1 + outcome.two_doubles), 0, target->health);
-            if(health_remaining < min_health_after_attack)
-            {
-                action = poss;
-                min_health_after_attack = health_remaining;
-            }
-        }
+        action = WeakestTarget(unit, map, possibilities);
     }
     return action;
 }
@@ -171,8 +261,10 @@ BossBehavior(const Unit &unit, const Tilemap &map)
     }
     else
     {
-        int min_health_after_attack = 999;
+        double min_health_after_attack = 999;
         Outcome outcome;
+        ProfileScope profile(PROFILE_SCORING);
+        GlobalAIProfiler.CountCandidates((int)possibilities.size());
 
         action = {unit.pos, NULL};
         for(const pair<position, Unit *> &poss : possibilities)
@@ -187,7 +279,7 @@ BossBehavior(const Unit &unit, const Tilemap &map)
                                         map.tiles[target->pos.col][target->pos.row].avoid,
                                         map.tiles[p.col][p.row].defense,
                                         map.tiles[target->pos.col][target->pos.row].defense);
-                int health_remaining = clamp(target->health - outcome.two_damage * (1 + outcome.two_doubles), 0, target->health);
+                double health_remaining = DistributeFight(outcome, unit.health, target->health).two_health;
                 if(health_remaining < min_health_after_attack)
                 {
                     action = poss;
@@ -214,47 +306,11 @@ AttackInRangeBehavior(const Unit &unit, const Tilemap &map, bool extended)
         if(extended_poss.empty())
             action = {unit.pos, NULL};
         else
-        {
-            Unit *nearest = FindNearest(map, unit.pos,
-                [](const Unit &unit) -> bool
-                {
-                    return unit.is_ally;
-                }, false);
-            path path_to_nearest = GetPath(map, unit.pos, nearest->pos, false);
-            if(path_to_nearest.size())
-            {
-                position furthest = FurthestMovementOnPath(map, path_to_nearest, unit.movement);
-                if(furthest == position(0, 0))
-                {
-                    furthest = unit.pos;
-                }
-                action = pair<position, Unit *>(furthest, NULL);
-            }
-        }
+            action = {ApproachSquare(unit, map), NULL};
     }
     else
     {
-        int min_health_after_attack = 999;
-        Outcome outcome;
-
-        action = {unit.pos, NULL};
-        for(const pair<position, Unit *> &poss : possibilities)
-        {
-            const position &p = poss.first;
-            Unit *target = poss.second;
-            outcome = PredictCombat(unit, *target,
-                                    ManhattanDistance(p, target->pos),
-                                    map.tiles[p.col][p.row].avoid,
-                                    map.tiles[target->pos.col][target->pos.row].avoid,
-                                    map.tiles[p.col][p.row].defense,
-                                    map.tiles[target->pos.col][target->pos.row].defense);
-            int health_remaining = clamp(target->health - outcome.two_damage * (1 + outcome.two_doubles), 0, target->health);
-            if(health_remaining < min_health_after_attack)
-            {
-                action = poss;
-                min_health_after_attack = health_remaining;
-            }
-        }
+        action = WeakestTarget(unit, map, possibilities);
     }
     return action;
 }
@@ -263,7 +319,7 @@ AttackInRangeBehavior(const Unit &unit, const Tilemap &map, bool extended)
 // Scans the map and determines the best course of action to take.
 // Uses techniques specified by the unit's ai_behavior field.
 pair<position, Unit *>
-GetAction(const Unit &unit, const Tilemap &map)
+DecideAction(const Unit &unit, const Tilemap &map)
 {
     switch(unit.ai_behavior)
     {
@@ -282,20 +338,66 @@ GetAction(const Unit &unit, const Tilemap &map)
     }
 }
 
+// DecideAction, but only worked out once per board.
+// Expects map.accessible and map.double_range to have been filled in for the unit.
+pair<position, Unit *>
+GetAction(const Unit &unit, const Tilemap &map)
+{
+    // NOTE: The unit's own key, not its name. Same-named units are different
+    // pieces, standing in different places.
+    uint64_t key = Mix64(map.Hash()) ^
+                   Mix64(unit.zobrist ^ Mix64(((uint64_t)unit.ai_behavior << 32) ^ (uint32_t)unit.turns_active));
+
+    CachedAction cached;
+    if(GlobalActionCache.Find(key, &cached))
+    {
+        GlobalAIProfiler.MarkCached();
+        if(cached.target == position(-1, -1))
+            return {cached.move, nullptr};
+        Unit *target = map.tiles[cached.target.col][cached.target.row].occupant;
+        if(target)
+            return {cached.move, target};
+    }
+
+    pair<position, Unit *> action = DecideAction(unit, map);
+    cached = {action.first, action.second ? action.second->pos : position(-1, -1)};
+    GlobalActionCache.Store(key, cached);
+    return action;
+}
+
 class AIPerformUnitActionCommand : public Command
 {
 public:
     AIPerformUnitActionCommand(Cursor *cursor_in, Tilemap *map_in,
-                               Fight *fight_in)
+                               Fight *fight_in, RolloutPlanner *planner_in)
     : cursor(cursor_in),
       map(map_in),
-      fight(fight_in)
+      fight(fight_in),
+      planner(planner_in)
     {}
 
     virtual void Execute()
+    {
+        {
+            ProfileScope profile(PROFILE_OTHER);
+            Perform();
+        }
+        GlobalAIProfiler.EndDecision();
+    }
+
+private:
+    void
+    Perform()
     {
         // Find target
-        pair<position, Unit *> action = GetAction(*cursor->selected, *map);
+        pair<position, Unit *> action;
+        if(planner->active)
+        {
+            ProfileScope rollout(PROFILE_ROLLOUT);
+            action = planner->Finish();
+        }
+        else
+            action = GetAction(*cursor->selected, *map);
         SDL_assert(!(action.first == position(0, 0)));
 
         // move cursor
@@ -305,7 +407,7 @@ public:
         map->tiles[cursor->redo.col][cursor->redo.row].occupant = nullptr;
         map->tiles[cursor->pos.col][cursor->pos.row].occupant = cursor->selected;
 
-        cursor->selected->pos = cursor->pos;
+        cursor->selected->SetPosition(cursor->pos);
         cursor->source = cursor->pos;
         cursor->selected->sheet.ChangeTrack(TRACK_ACTIVE);
 
@@ -344,10 +446,10 @@ public:
         return;
     }
 
-private:
     Cursor *cursor;
     Tilemap *map;
     Fight *fight;
+    RolloutPlanner *planner;
 };
 
 // ============================== struct ====================================
@@ -359,12 +461,76 @@ struct AI
     void Plan(Cursor *cursor, Tilemap *map, Fight *fight)
     {
         commandQueue.push(make_shared<AIFindNextUnitCommand>(cursor, *map));
-        commandQueue.push(make_shared<AISelectUnitCommand>(cursor, map));
-        commandQueue.push(make_shared<AIPerformUnitActionCommand>(cursor, map, fight));
+        commandQueue.push(make_shared<AISelectUnitCommand>(cursor, map, &planner));
+        commandQueue.push(make_shared<AIPerformUnitActionCommand>(cursor, map, fight, &planner));
+    }
+
+    // Plays out the rest of the enemy phase right now. Runs the same commands
+    // as the paced version, one unit after another, but lands each fight at
+    // once and hands out experience directly. Leaves a summary in the log.
+    void ResolvePhase(Cursor *cursor, Level *level, Fight *fight, CombatLog *log)
+    {
+        commandQueue = {};
+        log->Clear();
+
+        int acted = 0;
+        int fought = 0;
+        int fell = 0;
+        while(!GlobalPlayerTurn && GlobalInterfaceState != GAME_OVER)
+        {
+            AIFindNextUnitCommand(cursor, level->map).Execute();
+            if(GlobalPlayerTurn)
+                break;
+            AISelectUnitCommand(cursor, &level->map, &planner).Execute();
+            AIPerformUnitActionCommand(cursor, &level->map, fight, &planner).Execute();
+            ++acted;
+
+            if(GlobalAIState != AI_FIGHT)
+                continue;
+
+            Unit *one = fight->one;
+            Unit *two = fight->two;
+            int one_before = one->health;
+            int two_before = two->health;
+            fight->ResolveInstantly();
+
+            string line = one->name + " attacks " + two->name + ": " +
+                          to_string(two_before - two->health) + " dealt, " +
+                          to_string(one_before - one->health) + " taken.";
+            if(two->should_die)
+            {
+                line += " " + two->name + " falls.";
+                ++fell;
+            }
+            if(one->should_die)
+            {
+                line += " " + one->name + " falls.";
+                ++fell;
+            }
+            if(fought < COMBAT_LOG_LINES)
+                log->Add(line);
+            ++fought;
+
+            // NOTE: As in the paced version (see Fight.Update()), an attacker
+            // that fells its target isn't spent, and goes again.
+            if(!two->should_die)
+            {
+                two->GrantExperience(fight->Experience());
+                one->Deactivate();
+            }
+            level->RemoveDeadUnits();
+            GlobalAIState = FINDING_NEXT;
+        }
+
+        if(fought > COMBAT_LOG_LINES)
+            log->Add("...and " + to_string(fought - COMBAT_LOG_LINES) + " more.");
+        log->Add("Enemy phase | " + to_string(acted) + " acted, " +
+                 to_string(fought) + " fought, " + to_string(fell) + " fell.");
+        log->Show();
     }
 
     // Passes the args through to plan.
-    void Update(Cursor *cursor, Tilemap *map, Fight *fight)
+    void Update(Cursor *cursor, Level *level, Fight *fight, CombatLog *log)
     {
         if(GlobalPlayerTurn)
             return;
@@ -373,9 +539,15 @@ struct AI
            GlobalAIState == AI_RESOLVING_EXPERIENCE) // TODO: Simplify these states. Reduce bugs.
             return;
 
+        if(GlobalPhaseSpeed == PHASE_SPEED_INSTANT)
+        {
+            ResolvePhase(cursor, level, fight, log);
+            return;
+        }
+
         if(commandQueue.empty())
         {
-            Plan(cursor, map, fight);
+            Plan(cursor, &level->map, fight);
             // TODO: Bug with Experience Parceling
         }
         
@@ -392,8 +564,11 @@ struct AI
     void clearQueue()
     {
         commandQueue = {};
+        planner.ResetBudget();
     }
 
+    RolloutPlanner planner;
+
 private:
     queue<shared_ptr<Command>> commandQueue;
 };
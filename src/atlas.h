@@ -0,0 +1,130 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Atlas
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_STATIC
+#include "imstb_rectpack.h"
+
+// ================================ Sprite Atlas ===============================
+// Every unit's sheet, and the cursor, are packed onto a few big textures at
+// startup, so the map's sprites can be drawn a page at a time instead of a
+// unit at a time. See SpriteBatch in render.h.
+//
+// A packed sheet's Texture is its atlas page, under the sheet's own name, and
+// the Spritesheet keeps where on the page it is. Anything that wasn't packed,
+// like a sheet picked in the editor later on, gets a texture of its own as
+// before. LoadSpritesheet() handles either.
+
+struct SpriteAtlas
+{
+    struct Region
+    {
+        int page;
+        SDL_Rect rect;
+    };
+
+    vector<Texture> pages = {};
+    unordered_map<string, Region> regions = {}; // By path and filename.
+
+    // Packs the images onto as few pages as they fit on, ATLAS_SIZE square at
+    // most. Replaces whatever was packed before.
+    void
+    Pack(const string &path, const vector<string> &filenames)
+    {
+        Clear();
+        if(HEADLESS)
+            return;
+
+        // Decoded all at once, on the workers.
+        for(const string &filename : filenames)
+            GlobalTextureCache.Request(path, filename);
+
+        vector<SDL_Surface *> surfaces(filenames.size(), nullptr);
+        vector<stbrp_rect> rects = {};
+        for(int i = 0; i < filenames.size(); ++i)
+        {
+            SDL_Surface *decoded = GlobalTextureCache.TakeSurface(path, filenames[i]);
+            if(!decoded)
+            {
+                cout << "WARN SpriteAtlas.Pack: Couldn't load " << path << filenames[i] << "\n";
+                continue;
+            }
+            // NOTE: Converted, so that a palette's transparent color comes
+            // out as alpha.
+            surfaces[i] = SDL_ConvertSurfaceFormat(decoded, SDL_PIXELFORMAT_RGBA32, 0);
+            SDL_FreeSurface(decoded);
+            SDL_assert(surfaces[i]);
+            SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+
+            stbrp_rect rect = {};
+            rect.id = i;
+            rect.w = surfaces[i]->w + 1; // A pixel apart, so nothing bleeds.
+            rect.h = surfaces[i]->h + 1;
+            rects.push_back(rect);
+        }
+
+        vector<stbrp_node> nodes(ATLAS_SIZE);
+        while(!rects.empty())
+        {
+            stbrp_context context;
+            stbrp_init_target(&context, ATLAS_SIZE, ATLAS_SIZE, nodes.data(), (int)nodes.size());
+            stbrp_pack_rects(&context, rects.data(), (int)rects.size());
+
+            int height = 0;
+            for(const stbrp_rect &rect : rects)
+                if(rect.was_packed)
+                    height = max(height, (int)(rect.y + rect.h));
+            if(!height)
+            {
+                cout << "WARN SpriteAtlas.Pack: " << rects.size() << " sheets don't fit in "
+                     << ATLAS_SIZE << "x" << ATLAS_SIZE << ". They'll load on their own.\n";
+                break;
+            }
+
+            SDL_Surface *page = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_SIZE, height, 32,
+                                                               SDL_PIXELFORMAT_RGBA32);
+            SDL_assert(page);
+            vector<stbrp_rect> left = {};
+            for(const stbrp_rect &rect : rects)
+            {
+                if(!rect.was_packed)
+                {
+                    left.push_back(rect);
+                    continue;
+                }
+                SDL_Surface *surface = surfaces[rect.id];
+                SDL_Rect destination = {rect.x, rect.y, surface->w, surface->h};
+                SDL_BlitSurface(surface, NULL, page, &destination);
+                regions[path + filenames[rect.id]] = {(int)pages.size(), destination};
+            }
+
+            SDL_Texture *texture = SDL_CreateTextureFromSurface(GlobalRenderer, page);
+            SDL_assert(texture);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            pages.push_back(Texture(GlobalTextureCache.Add(texture, "", TEXTURE_SPRITE, ATLAS_SIZE, height),
+                                    path, "atlas" + to_string(pages.size()), ATLAS_SIZE, height));
+            SDL_FreeSurface(page);
+            rects = left;
+        }
+
+        for(SDL_Surface *surface : surfaces)
+            if(surface)
+                SDL_FreeSurface(surface);
+    }
+
+    // NOTE: Sheets already handed out keep their pages until they're done.
+    void
+    Clear()
+    {
+        pages.clear();
+        regions.clear();
+    }
+};
+
+static SpriteAtlas GlobalSpriteAtlas;
+
+#endif
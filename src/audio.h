@@ -24,6 +24,10 @@ struct Sound
     Sound(const string &name_in, AudioType type_in)
     : name(name_in)
     {
+        // Headless sounds are just names, so levels can still refer to them.
+        if(HEADLESS)
+            return;
+
         switch(type_in)
         {
             case MUSIC:
@@ -50,13 +54,17 @@ struct Sound
 
     ~Sound()
     {
-        ma_sound_uninit(&sound);
+        if(!HEADLESS)
+            ma_sound_uninit(&sound);
         delete volume_animation;
     }
 
     void
     Update()
     {
+        if(HEADLESS)
+            return;
+
         if(volume_animation)
         {
             float value = volume_animation->Value(CHANNEL_ONE);
@@ -76,12 +84,16 @@ struct Sound
     void
     Pause()
     {
+        if(HEADLESS)
+            return;
         ma_sound_stop(&sound);
     }
 
     void
     Stop()
     {
+        if(HEADLESS)
+            return;
         ma_sound_stop(&sound);
         ma_sound_seek_to_pcm_frame(&sound, 0);
     }
@@ -95,6 +107,8 @@ struct Sound
     void
     Start()
     {
+        if(HEADLESS)
+            return;
         delete volume_animation;
         volume_animation = nullptr;
 
@@ -105,6 +119,8 @@ struct Sound
     void
     Restart()
     {
+        if(HEADLESS)
+            return;
         ma_sound_seek_to_pcm_frame(&sound, 0);
         Start();
     }
@@ -119,6 +135,66 @@ struct AudioBank
 static AudioBank GlobalMusic;
 static AudioBank GlobalSfx;
 
+// Fills the music and sound effect banks.
+void
+LoadSounds()
+{
+    GlobalMusic.sounds =
+    {
+        new Sound("spiny.wav", MUSIC),
+        new Sound("r4.wav", MUSIC),
+        new Sound("qc.wav", MUSIC),
+        new Sound("6.wav", MUSIC),
+        new Sound("13.wav", MUSIC),
+        new Sound("21.wav", MUSIC),
+        new Sound("tripod.wav", MUSIC),
+        new Sound("fs.wav", MUSIC),
+        new Sound("spacelion.wav", MUSIC),
+        new Sound("fire.wav", MUSIC),
+        new Sound("boat.wav", MUSIC),
+        new Sound("forest.wav", MUSIC),
+        new Sound("town.wav", MUSIC),
+        new Sound("gerudo.wav", MUSIC),
+        new Sound("village.wav", MUSIC),
+        new Sound("hamduche.wav", MUSIC),
+        new Sound("wind.wav", MUSIC),
+        new Sound("chrono.wav", MUSIC),
+        new Sound("title.wav", MUSIC)
+    };
+
+    GlobalSfx.sounds =
+    {
+        new Sound("mov.wav", SFX),
+        new Sound("crit.wav", SFX),
+        new Sound("heal.wav", SFX),
+        new Sound("hit1.wav", SFX),
+        new Sound("hit2.wav", SFX),
+        new Sound("hit3.wav", SFX),
+        new Sound("magic.wav", SFX),
+        new Sound("miss.wav", SFX),
+        new Sound("pickup.wav", SFX),
+        new Sound("place.wav", SFX),
+        new Sound("powerup.wav", SFX),
+        new Sound("ranged.wav", SFX),
+        new Sound("sel1.wav", SFX),
+        new Sound("sel2.wav", SFX),
+        new Sound("sel3.wav", SFX),
+        new Sound("start.wav", SFX),
+        new Sound("dance.wav", SFX)
+    };
+}
+
+void
+UnloadSounds()
+{
+    for(Sound *sound : GlobalMusic.sounds)
+        delete sound;
+    for(Sound *sound : GlobalSfx.sounds)
+        delete sound;
+    GlobalMusic.sounds.clear();
+    GlobalSfx.sounds.clear();
+}
+
 Sound *
 GetMusic(const string &name)
 {
@@ -196,11 +272,15 @@ PlaySfx(const string &filename)
 void
 SetMusicVolume(float volume)
 {
+    if(HEADLESS)
+        return;
     ma_sound_group_set_volume(&(GlobalMusicGroup), volume);
 }
 void
 SetSfxVolume(float volume)
 {
+    if(HEADLESS)
+        return;
     ma_sound_group_set_volume(&(GlobalSfxGroup), volume);
 }
 
@@ -370,7 +370,7 @@ public:
             level->map.tiles[cursor->redo.col][cursor->redo.row].occupant = nullptr;
             level->map.tiles[cursor->pos.col][cursor->pos.row].occupant = cursor->selected;
 
-            cursor->selected->pos = cursor->pos;
+            cursor->selected->SetPosition(cursor->pos);
             cursor->selected->sheet.ChangeTrack(TRACK_ACTIVE);
             EmitEvent(PLACE_UNIT_EVENT);
             return;
@@ -406,7 +406,7 @@ public:
 
         cursor->path_draw = {};
 
-        cursor->selected->pos = cursor->pos;
+        cursor->selected->SetPosition(cursor->pos);
         cursor->selected->sheet.ChangeTrack(TRACK_IDLE);
 
         EmitEvent(PICK_UP_UNIT_EVENT);
@@ -954,8 +954,9 @@ public:
 class ChooseGameMenuOptionCommand : public Command
 {
 public:
-    ChooseGameMenuOptionCommand(Menu *menu_in)
-    : menu(menu_in)
+    ChooseGameMenuOptionCommand(Menu *menu_in, Cursor *cursor_in)
+    : menu(menu_in),
+      cursor(cursor_in)
     {}
 
     virtual void Execute()
@@ -978,11 +979,43 @@ public:
                 GlobalTurnStart = true;
                 EmitEvent(END_PLAYER_TURN_EVENT);
             } break;
+            case(3): // REWIND
+            {
+                if(!GlobalJournal)
+                    break;
+                Unit *unit = GlobalJournal->RewindPlayerAction();
+                if(!unit)
+                    break;
+                cursor->selected = nullptr;
+                cursor->targeted = nullptr;
+                cursor->PlaceAt(unit->pos);
+                GlobalInterfaceState = NEUTRAL_OVER_UNIT;
+            } break;
         }
     }
 
 private:
     Menu *menu;
+    Cursor *cursor;
+};
+
+// Steps through the enemy phase speeds, from 1x up to instant.
+class ChangePhaseSpeedCommand : public Command
+{
+public:
+    ChangePhaseSpeedCommand(int direction_in)
+    : direction(direction_in)
+    {}
+
+    virtual void Execute()
+    {
+        EmitEvent(MOVE_MENU_EVENT);
+        GlobalPhaseSpeed = (PhaseSpeed)clamp(GlobalPhaseSpeed + direction,
+                                             PHASE_SPEED_1X, PHASE_SPEED_INSTANT);
+    }
+
+private:
+    int direction;
 };
 
 class BackToGameMenuCommand : public Command
@@ -1783,7 +1816,7 @@ public:
                 BindDown(make_shared<UpdateMenuCommand>(gameMenu, 1));
                 BindLeft(make_shared<NullCommand>());
                 BindRight(make_shared<NullCommand>());
-                BindA(make_shared<ChooseGameMenuOptionCommand>(gameMenu));
+                BindA(make_shared<ChooseGameMenuOptionCommand>(gameMenu, cursor));
                 BindB(make_shared<ExitGameMenuCommand>());
                 BindR(make_shared<NullCommand>());
             } break;
@@ -1801,8 +1834,8 @@ public:
             {
                 BindUp(make_shared<NullCommand>());
                 BindDown(make_shared<NullCommand>());
-                BindLeft(make_shared<NullCommand>());
-                BindRight(make_shared<NullCommand>());
+                BindLeft(make_shared<ChangePhaseSpeedCommand>(-1));
+                BindRight(make_shared<ChangePhaseSpeedCommand>(1));
                 BindA(make_shared<NullCommand>());
                 BindB(make_shared<BackToGameMenuCommand>());
                 BindR(make_shared<NullCommand>());
@@ -0,0 +1,565 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Compile
+
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ============================== Compiled Levels ==============================
+// The level files, packed so that loading one is a matter of reading it in
+// and picking it up where it lies. No lines, no splitting, no stoi. Written by
+// tools/compile_levels (make levels) next to the text, as l0.txt -> l0.lvl.
+//
+// The level's conversations are packed in with it, speakers and all, since
+// opening and reading each of those files is most of what loading the text
+// costs. A compiled level is one file to read, where the text is one per
+// conversation as well.
+//
+// LoadLevel() takes the compiled copy when there is one, it's no older than
+// the text or any of its conversations, and it checks out. Otherwise it reads
+// the text, as before, so the text is still the one to edit.
+//
+// File | LevelHeader, then the sections it points to, each on four bytes:
+//        tiles     | width * height TileTypes, a byte each, column by column.
+//        spawns    | LevelSpawns, in the order they were in the text.
+//        assets    | LevelAssets. The atlas, conversations, and song.
+//        sentences | LevelSentences. Each conversation's run of them in turn.
+//        strings   | The names and lines the other sections refer to.
+//
+// NOTE: Fields are as they sit in memory, so a compiled level only loads on a
+// machine with the same byte order as the one that wrote it. The checksum
+// catches the rest.
+
+#define LEVEL_MAGIC "EMLV"
+#define LEVEL_VERSION 2
+#define LEVEL_EXTENSION ".lvl"
+
+// Somewhere in the string table.
+struct LevelString
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct LevelHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t size;          // Of the whole file.
+    uint32_t checksum;      // Of everything after the header. See Checksum().
+
+    uint32_t objective;
+    uint16_t width;
+    uint16_t height;
+
+    uint32_t tiles;         // Offsets from the start of the file.
+    uint32_t spawns;
+    uint32_t spawn_count;
+    uint32_t assets;
+    uint32_t asset_count;
+    uint32_t sentences;
+    uint32_t sentence_count;
+    uint32_t strings;
+    uint32_t strings_size;
+};
+
+struct LevelSpawn
+{
+    LevelString name;
+    int16_t col;
+    int16_t row;
+    uint8_t ai_behavior;
+    uint8_t is_boss;
+    uint8_t pad[2];
+};
+
+enum LevelAssetType
+{
+    LEVEL_ASSET_ATLAS,
+    LEVEL_ASSET_PRELUDE,
+    LEVEL_ASSET_MID_BATTLE,
+    LEVEL_ASSET_VILLAGE,
+    LEVEL_ASSET_CONVERSATION,
+    LEVEL_ASSET_MUSIC,
+    LEVEL_ASSET_TYPES,
+};
+
+struct LevelAsset
+{
+    LevelString name;
+    uint8_t type;
+    uint8_t pad[3];
+    int16_t col;            // Villages only.
+    int16_t row;
+
+    // Conversations only. What LoadConversation() reads out of the file.
+    LevelString one;
+    LevelString two;
+    LevelString song;       // Empty for none.
+    uint32_t first_sentence;
+    uint32_t sentence_count;
+};
+
+struct LevelSentence
+{
+    LevelString text;
+    uint8_t speaker;
+    uint8_t expression;
+    uint8_t event;
+    uint8_t pad;
+};
+
+static_assert(sizeof(LevelHeader) == 60, "LevelHeader is written as is.");
+static_assert(sizeof(LevelSpawn) == 16, "LevelSpawn is written as is.");
+static_assert(sizeof(LevelAsset) == 48, "LevelAsset is written as is.");
+static_assert(sizeof(LevelSentence) == 12, "LevelSentence is written as is.");
+
+bool
+IsConversationAsset(uint8_t type)
+{
+    return type == LEVEL_ASSET_PRELUDE || type == LEVEL_ASSET_MID_BATTLE ||
+           type == LEVEL_ASSET_VILLAGE || type == LEVEL_ASSET_CONVERSATION;
+}
+
+// Where an asset's file is, for the ones read from one.
+string
+LevelAssetPath(uint8_t type)
+{
+    switch(type)
+    {
+        case(LEVEL_ASSET_PRELUDE):      return PRELUDES_PATH;
+        case(LEVEL_ASSET_MID_BATTLE):   return CONVERSATIONS_PATH;
+        case(LEVEL_ASSET_VILLAGE):      return VILLAGES_PATH;
+        case(LEVEL_ASSET_CONVERSATION): return CONVERSATIONS_PATH;
+        default: return "";
+    }
+}
+
+// FNV-1a. Catches a file that's been cut short or scribbled on, nothing more.
+uint32_t
+Checksum(const uint8_t *data, size_t size)
+{
+    uint32_t result = 2166136261u;
+    for(size_t i = 0; i < size; ++i)
+        result = (result ^ data[i]) * 16777619u;
+    return result;
+}
+
+string
+CompiledLevelName(const string &filename)
+{
+    size_t dot = filename.rfind('.');
+    size_t slash = filename.rfind('/');
+    if(dot == string::npos || (slash != string::npos && dot < slash))
+        return filename + LEVEL_EXTENSION;
+    return filename.substr(0, dot) + LEVEL_EXTENSION;
+}
+
+// ================================= Writing ===================================
+struct LevelWriter
+{
+    vector<uint8_t> bytes = {};
+    vector<uint8_t> strings = {};
+
+    template <typename T>
+    uint32_t
+    Add(const T &value)
+    {
+        uint32_t at = (uint32_t)bytes.size();
+        const uint8_t *start = (const uint8_t *)&value;
+        bytes.insert(bytes.end(), start, start + sizeof(T));
+        return at;
+    }
+
+    LevelString
+    String(const string &value)
+    {
+        LevelString result = {(uint32_t)strings.size(), (uint32_t)value.size()};
+        strings.insert(strings.end(), value.begin(), value.end());
+        return result;
+    }
+
+    uint32_t
+    Align()
+    {
+        while(bytes.size() % 4)
+            bytes.push_back(0);
+        return (uint32_t)bytes.size();
+    }
+};
+
+LevelAsset
+MakeLevelAsset(LevelWriter *writer, LevelAssetType type, const string &name,
+               const position &pos = position(-1, -1))
+{
+    LevelAsset asset = {};
+    asset.name = writer->String(name);
+    asset.type = type;
+    asset.col = pos.col;
+    asset.row = pos.row;
+    return asset;
+}
+
+// A conversation, with everything that was read out of its file.
+LevelAsset
+MakeConversationAsset(LevelWriter *writer, LevelAssetType type, const Conversation &conv,
+                      vector<LevelSentence> *sentences)
+{
+    LevelAsset asset = MakeLevelAsset(writer, type, conv.filename, conv.pos);
+    asset.one = writer->String(conv.one->name);
+    asset.two = writer->String(conv.two->name);
+    asset.song = writer->String(conv.song ? conv.song->name : "");
+    asset.first_sentence = (uint32_t)sentences->size();
+    asset.sentence_count = (uint32_t)conv.prose.size();
+    for(const Sentence &sentence : conv.prose)
+    {
+        LevelSentence packed = {};
+        packed.text = writer->String(sentence.text);
+        packed.speaker = sentence.speaker;
+        packed.expression = sentence.expression;
+        packed.event = sentence.event;
+        sentences->push_back(packed);
+    }
+    return asset;
+}
+
+// Packs a level as it was loaded. Run it on what LoadLevelText() gives back,
+// before anyone's moved. Returns false if the file couldn't be written.
+bool
+CompileLevel(const Level &level, const string &filename)
+{
+    LevelWriter writer;
+    LevelHeader header = {};
+    memcpy(header.magic, LEVEL_MAGIC, 4);
+    header.version = LEVEL_VERSION;
+    header.objective = level.objective;
+    header.width = level.map.width;
+    header.height = level.map.height;
+    writer.Add(header);
+
+    header.tiles = writer.Align();
+    for(int col = 0; col < level.map.width; ++col)
+        for(int row = 0; row < level.map.height; ++row)
+            writer.Add((uint8_t)level.map.tiles[col][row].type);
+
+    header.spawns = writer.Align();
+    header.spawn_count = (uint32_t)level.combatants.size();
+    for(const shared_ptr<Unit> &unit : level.combatants)
+    {
+        LevelSpawn spawn = {};
+        spawn.name = writer.String(unit->name);
+        spawn.col = unit->pos.col;
+        spawn.row = unit->pos.row;
+        spawn.ai_behavior = unit->ai_behavior;
+        spawn.is_boss = unit->is_boss;
+        writer.Add(spawn);
+    }
+
+    // In the order LoadLevelText() meets them in the files as SaveLevel()
+    // writes them, so the conversations load the same either way.
+    vector<LevelAsset> assets = {};
+    vector<LevelSentence> sentences = {};
+    assets.push_back(MakeLevelAsset(&writer, LEVEL_ASSET_ATLAS, level.map.atlas.filename));
+    if(level.conversations.prelude.one)
+        assets.push_back(MakeConversationAsset(&writer, LEVEL_ASSET_PRELUDE,
+                                               level.conversations.prelude, &sentences));
+    for(const Conversation &conv : level.conversations.mid_battle)
+        assets.push_back(MakeConversationAsset(&writer, LEVEL_ASSET_MID_BATTLE, conv, &sentences));
+    for(const Conversation &conv : level.conversations.villages)
+        assets.push_back(MakeConversationAsset(&writer, LEVEL_ASSET_VILLAGE, conv, &sentences));
+    for(const Conversation &conv : level.conversations.list)
+        assets.push_back(MakeConversationAsset(&writer, LEVEL_ASSET_CONVERSATION, conv, &sentences));
+    if(level.song)
+        assets.push_back(MakeLevelAsset(&writer, LEVEL_ASSET_MUSIC, level.song->name));
+
+    header.assets = writer.Align();
+    header.asset_count = (uint32_t)assets.size();
+    for(const LevelAsset &asset : assets)
+        writer.Add(asset);
+
+    header.sentences = writer.Align();
+    header.sentence_count = (uint32_t)sentences.size();
+    for(const LevelSentence &sentence : sentences)
+        writer.Add(sentence);
+
+    header.strings = writer.Align();
+    header.strings_size = (uint32_t)writer.strings.size();
+    writer.bytes.insert(writer.bytes.end(), writer.strings.begin(), writer.strings.end());
+
+    header.size = (uint32_t)writer.bytes.size();
+    header.checksum = Checksum(writer.bytes.data() + sizeof(LevelHeader),
+                               writer.bytes.size() - sizeof(LevelHeader));
+    memcpy(writer.bytes.data(), &header, sizeof(LevelHeader));
+
+    ofstream fp(filename, ios::binary);
+    if(!fp.is_open())
+    {
+        cout << "WARN CompileLevel: Couldn't open " << filename << "\n";
+        return false;
+    }
+    fp.write((const char *)writer.bytes.data(), writer.bytes.size());
+    return (bool)fp;
+}
+
+// ================================= Loading ===================================
+// A compiled level, read in whole.
+//
+// NOTE: Read, not mapped. Levels are a few kilobytes, and for files that
+// small, setting up and tearing down a mapping costs twice what copying does.
+struct LevelFile
+{
+    vector<uint8_t> bytes = {};
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    time_t modified = 0;
+
+    bool
+    Open(const string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+
+        struct stat info = {};
+        if(fstat(fd, &info) || info.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        bytes.resize(info.st_size);
+        size_t got = 0;
+        while(got < bytes.size())
+        {
+            ssize_t count = read(fd, bytes.data() + got, bytes.size() - got);
+            if(count <= 0)
+                break;
+            got += count;
+        }
+        close(fd);
+        if(got != bytes.size())
+            return false;
+
+        data = bytes.data();
+        size = bytes.size();
+        modified = info.st_mtime;
+        return true;
+    }
+};
+
+// Whether count things of this size fit at offset, in a file of this size.
+bool
+InBounds(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_size)
+{
+    return offset % 4 == 0 && offset + count * size <= file_size;
+}
+
+bool
+InBounds(const LevelString &name, const LevelHeader &header)
+{
+    return (uint64_t)name.offset + name.length <= header.strings_size;
+}
+
+string
+StringAt(const LevelFile &file, const LevelHeader &header, const LevelString &name)
+{
+    return string((const char *)file.data + header.strings + name.offset, name.length);
+}
+
+// Everything LoadCompiledLevel() is about to read, checked before it's read.
+// Returns the header, or nullptr with the reason why printed.
+const LevelHeader *
+CheckCompiledLevel(const LevelFile &file, const string &filename)
+{
+    if(file.size < sizeof(LevelHeader))
+    {
+        cout << "WARN CheckCompiledLevel: " << filename << " is cut short.\n";
+        return nullptr;
+    }
+
+    const LevelHeader *header = (const LevelHeader *)file.data;
+    if(memcmp(header->magic, LEVEL_MAGIC, 4) || header->version != LEVEL_VERSION)
+    {
+        cout << "WARN CheckCompiledLevel: " << filename << " isn't a version "
+             << LEVEL_VERSION << " level. Recompile it with make levels.\n";
+        return nullptr;
+    }
+    if(header->size != file.size ||
+       header->checksum != Checksum(file.data + sizeof(LevelHeader),
+                                    file.size - sizeof(LevelHeader)))
+    {
+        cout << "WARN CheckCompiledLevel: " << filename << " doesn't match its checksum.\n";
+        return nullptr;
+    }
+
+    bool ok = header->objective <= OBJECTIVE_BOSS &&
+              InBounds(header->tiles, (uint64_t)header->width * header->height, 1, file.size) &&
+              InBounds(header->spawns, header->spawn_count, sizeof(LevelSpawn), file.size) &&
+              InBounds(header->assets, header->asset_count, sizeof(LevelAsset), file.size) &&
+              InBounds(header->sentences, header->sentence_count, sizeof(LevelSentence), file.size) &&
+              InBounds(header->strings, header->strings_size, 1, file.size);
+
+    const uint8_t *tiles = file.data + header->tiles;
+    for(uint32_t i = 0; ok && i < (uint32_t)header->width * header->height; ++i)
+        ok = tiles[i] <= CHEST;
+
+    const LevelSpawn *spawns = (const LevelSpawn *)(file.data + header->spawns);
+    for(uint32_t i = 0; ok && i < header->spawn_count; ++i)
+        ok = InBounds(spawns[i].name, *header) &&
+             spawns[i].col >= 0 && spawns[i].col < header->width &&
+             spawns[i].row >= 0 && spawns[i].row < header->height;
+
+    const LevelAsset *assets = (const LevelAsset *)(file.data + header->assets);
+    for(uint32_t i = 0; ok && i < header->asset_count; ++i)
+    {
+        const LevelAsset &asset = assets[i];
+        ok = InBounds(asset.name, *header) && asset.type < LEVEL_ASSET_TYPES;
+        // NOTE: A conversation shows its first sentence as soon as it's loaded.
+        if(ok && IsConversationAsset(asset.type))
+            ok = InBounds(asset.one, *header) && InBounds(asset.two, *header) &&
+                 InBounds(asset.song, *header) && asset.sentence_count &&
+                 (uint64_t)asset.first_sentence + asset.sentence_count <= header->sentence_count;
+    }
+
+    const LevelSentence *sentences = (const LevelSentence *)(file.data + header->sentences);
+    for(uint32_t i = 0; ok && i < header->sentence_count; ++i)
+        ok = InBounds(sentences[i].text, *header) && sentences[i].speaker <= SPEAKER_TWO &&
+             sentences[i].expression <= EXPR_WINCE && sentences[i].event <= CONV_TWO_ENTERS;
+
+    if(!ok)
+    {
+        cout << "WARN CheckCompiledLevel: " << filename << " points outside itself.\n";
+        return nullptr;
+    }
+    return header;
+}
+
+// Whether the text, or any conversation packed in with it, has been edited
+// since the level was compiled.
+bool
+IsStale(const LevelFile &file, const LevelHeader &header, const string &text)
+{
+    struct stat info = {};
+    if(!stat(text.c_str(), &info) && info.st_mtime > file.modified)
+        return true;
+
+    const LevelAsset *assets = (const LevelAsset *)(file.data + header.assets);
+    for(uint32_t i = 0; i < header.asset_count; ++i)
+    {
+        if(!IsConversationAsset(assets[i].type))
+            continue;
+        string source = LevelAssetPath(assets[i].type) + StringAt(file, header, assets[i].name);
+        if(!stat(source.c_str(), &info) && info.st_mtime > file.modified)
+            return true;
+    }
+    return false;
+}
+
+// A conversation as LoadConversation() would have read it from its file.
+Conversation
+LoadCompiledConversation(const LevelFile &file, const LevelHeader &header,
+                         const LevelAsset &asset, const vector<shared_ptr<Unit>> &units)
+{
+    Conversation conversation = {};
+    conversation.filename = StringAt(file, header, asset.name);
+    conversation.pos = position(asset.col, asset.row);
+    if(asset.song.length)
+        conversation.song = GetMusic(StringAt(file, header, asset.song));
+    conversation.one = GetUnitByName(units, StringAt(file, header, asset.one));
+    conversation.two = GetUnitByName(units, StringAt(file, header, asset.two));
+
+    const LevelSentence *sentences = (const LevelSentence *)(file.data + header.sentences);
+    conversation.prose.reserve(asset.sentence_count);
+    for(uint32_t i = asset.first_sentence; i < asset.first_sentence + asset.sentence_count; ++i)
+        conversation.prose.push_back({(Speaker)sentences[i].speaker,
+                                      StringAt(file, header, sentences[i].text),
+                                      (Expression)sentences[i].expression,
+                                      (ConversationEvent)sentences[i].event});
+
+    SDL_assert(conversation.one && conversation.two);
+    conversation.ReloadTextures();
+    return conversation;
+}
+
+// Loads the compiled copy of a level into level, if there's a current one
+// that checks out. Otherwise leaves level be and returns false.
+bool
+LoadCompiledLevel(const string &filename_in, const vector<shared_ptr<Unit>> &units,
+                  const vector<shared_ptr<Unit>> &party, Level *level)
+{
+    string text = DATA_PATH + filename_in;
+    string compiled = CompiledLevelName(text);
+
+    LevelFile file;
+    if(!file.Open(compiled))
+    {
+        if(errno != ENOENT)
+            cout << "WARN LoadCompiledLevel: Couldn't read " << compiled << "\n";
+        return false;
+    }
+    const LevelHeader *header = CheckCompiledLevel(file, compiled);
+    if(!header)
+        return false;
+    if(IsStale(file, *header, text))
+    {
+        cout << "WARN LoadCompiledLevel: " << compiled << " is older than the text or its "
+             << "conversations. Loading the text.\n";
+        return false;
+    }
+
+    level->objective = (Objective)header->objective;
+
+    const LevelAsset *assets = (const LevelAsset *)(file.data + header->assets);
+    for(uint32_t i = 0; i < header->asset_count; ++i)
+    {
+        const LevelAsset &asset = assets[i];
+        switch(asset.type)
+        {
+            case(LEVEL_ASSET_ATLAS):
+                level->map.atlas = LoadTextureImage(TILESETS_PATH, StringAt(file, *header, asset.name));
+                break;
+            case(LEVEL_ASSET_PRELUDE):
+                level->conversations.prelude = LoadCompiledConversation(file, *header, asset, units);
+                break;
+            case(LEVEL_ASSET_MID_BATTLE):
+                level->conversations.mid_battle.push_back(
+                    LoadCompiledConversation(file, *header, asset, units));
+                break;
+            case(LEVEL_ASSET_VILLAGE):
+                level->conversations.villages.push_back(
+                    LoadCompiledConversation(file, *header, asset, units));
+                break;
+            case(LEVEL_ASSET_CONVERSATION):
+                level->conversations.list.push_back(
+                    LoadCompiledConversation(file, *header, asset, units));
+                break;
+            case(LEVEL_ASSET_MUSIC):
+                level->song = GetMusic(StringAt(file, *header, asset.name));
+                break;
+        }
+    }
+
+    level->map.width = header->width;
+    level->map.height = header->height;
+    level->map.tiles.assign(header->width, vector<Tile>(header->height));
+    const uint8_t *tiles = file.data + header->tiles;
+    for(int col = 0; col < header->width; ++col)
+        for(int row = 0; row < header->height; ++row)
+            level->map.tiles[col][row] = TileTypeToTile((TileType)tiles[col * header->height + row]);
+
+    const LevelSpawn *spawns = (const LevelSpawn *)(file.data + header->spawns);
+    for(uint32_t i = 0; i < header->spawn_count; ++i)
+    {
+        const LevelSpawn &spawn = spawns[i];
+        SpawnUnit(level, StringAt(file, *header, spawn.name), spawn.col, spawn.row,
+                  (AIBehavior)spawn.ai_behavior, spawn.is_boss, units, party);
+    }
+    return true;
+}
+
+#endif
@@ -9,6 +9,12 @@
 // meta
 #define DEV_MODE 1
 
+// Headless builds never make a window, a texture or a sound. See src/tools/.
+#ifndef HEADLESS
+#define HEADLESS 0
+#endif
+#define HEADLESS_TEXTURE_SIZE 256 // Pretend size, so spritesheets still get tracks.
+
 // low level
 #define JOYSTICK_DEAD_ZONE 8000
 // TODO: Create a separate system for keyboard inputs
@@ -29,6 +35,9 @@
 #define SCREEN_HEIGHT 800
 
 #define PORTRAIT_SIZE 600
+#define PORTRAIT_BUDGET_MB 64 // Decoded portraits kept loaded. See portrait.h.
+#define UPLOAD_BUDGET_MS 2.0   // Streamed texture uploads a frame. See texture.h.
+#define ATLAS_SIZE 2048        // Widest and tallest a sprite atlas page gets. See atlas.h.
 #define SPRITE_SIZE 32
 #define ATLAS_TILE_SIZE 16
 
@@ -37,10 +46,33 @@
 #define CONV_MENU_WIDTH 400
 #define CONVERSATION_WRAP 840
 
+// simulation
+#define SIM_TICK_RATE 60            // Ticks a second. Everything counted in frames is counted in these.
+#define SIM_MAX_TICKS_PER_FRAME 8   // Past this many owed in a frame, the rest is dropped.
+
 // animation
 #define ANIMATION_SPEED 10
 #define AI_ACTION_SPEED 10
 
+// ai planning
+#define ROLLOUT_TURN_BUDGET_MS 1000 // Total thinking time for a whole enemy phase.
+#define ROLLOUT_UNIT_BUDGET_MS 100  // Must finish well within AI_ACTION_SPEED frames.
+#define ROLLOUT_KILL_BONUS 20       // Score for felling a unit, on top of the damage.
+#define ROLLOUT_LEADER_BONUS 100    // Score for felling the leader. Ends the game.
+#define TT_MOVEMENT_ENTRIES 256     // Cached movement fields. Power of two.
+#define TT_ACTION_ENTRIES 1024      // Cached actions. Power of two.
+#define FIGHT_CACHE_ENTRIES 4096    // Fight odds kept before starting over.
+#define INFLUENCE_DEFENSE_VALUE 5   // Avoid points one point of tile defense is worth.
+#define INFLUENCE_THREAT_WEIGHT 1   // Per point of attack that could land on a tile.
+#define INFLUENCE_SUPPORT_WEIGHT 10 // Per friendly healer or buffer in reach.
+#define INFLUENCE_CHASE_WEIGHT 20   // Per tile still between a pursuer and its prey.
+#define COMBAT_LOG_FRAMES 300       // How long an instant phase's summary stays up.
+#define COMBAT_LOG_LINES 8          // Most fights listed before the rest are summed up.
+#define AI_PROFILE_ENTRIES 256      // AI decisions the profiler remembers.
+
+// rewind
+#define JOURNAL_TURNS 16            // Turns of actions kept to take back.
+
 // startup
 #define INITIAL_LEVEL "l0.txt"
 #define INITIAL_UNITS "units.tsv"
@@ -50,6 +82,10 @@
 #define CONVERSATIONS_PATH "../data/conversations/"
 #define VILLAGES_PATH "../data/conversations/villages/"
 #define PRELUDES_PATH "../data/conversations/preludes/"
+#define LOGS_PATH "../logs/"
+#define SAVES_PATH "../saves/"
+#define QUICKSAVE_FILE "quick.snap"
+#define AUTOSAVE_FILE "autosave.snap"
 
 // assets
 #define MUSIC_PATH "../assets/music/"
@@ -68,6 +104,8 @@
 #define DOUBLE_RATIO 2    // How much a unit must beat another by to double them.
 #define CRIT_MULTIPLIER 2 // The multiplier on damage.
 
+#define MAX_LEVEL 10 // Units stop gaining experience here.
+
 #define EXP_FOR_COMBAT 5
 #define EXP_FOR_HEALING 10
 #define EXP_FOR_DANCE 10
@@ -149,6 +187,47 @@ enum AIState
     PLAYER_TURN, // 4
 };
 
+enum AIMode
+{
+    AI_MODE_GREEDY,  // Worst-case PredictCombat, one unit at a time.
+    AI_MODE_ROLLOUT, // Monte Carlo playouts of the rest of the phase.
+};
+
+// How fast the enemy phase plays out.
+enum PhaseSpeed
+{
+    PHASE_SPEED_1X,
+    PHASE_SPEED_2X,
+    PHASE_SPEED_4X,
+    PHASE_SPEED_8X,
+    PHASE_SPEED_INSTANT, // The whole phase in one frame. No animations.
+};
+
+// Independent random number streams. See RngStreams.
+// Drawing more from one never shifts what another hands out.
+enum RngStream
+{
+    RNG_HIT,    // Whether a swing lands.
+    RNG_CRIT,   // Whether a landed swing crits.
+    RNG_GROWTH, // Level up stat gains.
+    RNG_AI,     // Seeds for the AI's own simulations.
+    RNG_STREAMS,
+};
+
+// Where an AI decision spends its time. See profiler.h.
+enum ProfileSection
+{
+    PROFILE_OTHER,              // Everything not broken out below.
+    PROFILE_MOVEMENT,           // AccessibleAndAttackableFrom.
+    PROFILE_ATTACKING_SQUARES,  // FindAttackingSquares.
+    PROFILE_NEAREST,            // FindNearest, less the paths it asks for.
+    PROFILE_PATHS,              // GetField, and so GetPath.
+    PROFILE_INFLUENCE,          // Keeping the influence maps up to date.
+    PROFILE_SCORING,            // Weighing up candidate squares and targets.
+    PROFILE_ROLLOUT,            // Starting and collecting the rollout planner.
+    PROFILE_SECTIONS,
+};
+
 enum AIBehavior
 {
     NO_BEHAVIOR,
@@ -19,6 +19,7 @@ struct Cursor
     Animation *animation = nullptr;
     Animation *unit_animation = nullptr;
     position animation_offset = position(0, 0);
+    position last_offset = position(0, 0); // As of the tick before.
     direction animation_dir = direction(0, 0);
 
     Cursor(Spritesheet sheet_in)
@@ -74,7 +75,7 @@ struct Cursor
                 map->tiles[redo.col][redo.row].occupant = nullptr;
                 map->tiles[pos.col][pos.row].occupant = selected;
 
-                selected->pos = pos;
+                selected->SetPosition(pos);
                 selected->sheet.ChangeTrack(TRACK_ACTIVE);
 
                 selected->animation_offset = {0, 0};
@@ -30,6 +30,90 @@ Meta(Level *level)
     ImGui::End();
 }
 
+// Where the unit's stats could be by a given level. Worked out fresh each frame,
+// so it follows the sliders. Real level ups are sampled alongside, in the
+// background, whenever anything that goes into the projection changes.
+void
+GrowthProjector(const Unit &unit)
+{
+    static int target_level = MAX_LEVEL;
+    static GrowthProjection sampled = {};
+    static uint64_t sampled_key = 0;
+    static shared_ptr<GrowthSampling> sampling = nullptr;
+
+    ImGui::Text("projection");
+    ImGui::SliderInt("to level", &target_level, 1, MAX_LEVEL);
+    GrowthProjection exact = ProjectGrowths(unit, target_level);
+
+    // Anything that would change the projection.
+    uint64_t key = Mix64(((uint64_t)unit.level << 32) ^ (uint32_t)target_level);
+    for(int s = 0; s < GROWTH_STATS; ++s)
+    {
+        key = Mix64(key ^ (uint32_t)(unit.*GrowthStats[s].stat));
+        key = Mix64(key ^ (uint32_t)(unit.growths.*GrowthStats[s].growth));
+    }
+
+    // One run at a time. One that's out of date by the time it finishes is
+    // thrown away, and the next starts from wherever the sliders are then.
+    if(sampling && sampling->Done())
+    {
+        if(sampling->key == key)
+        {
+            sampled = sampling->Collect();
+            sampled_key = key;
+        }
+        sampling = nullptr;
+    }
+    if(!sampling && sampled_key != key)
+        sampling = StartSampleGrowths(unit, target_level, GROWTH_SAMPLES, key);
+
+    if(sampling)
+    {
+        ImGui::SameLine();
+        ImGui::Text("sampling...");
+    }
+    bool show_sampled = sampled.samples && sampled_key == key;
+
+    if(ImGui::BeginTable("projection", show_sampled ? 6 : 5,
+                         ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("stat");
+        ImGui::TableSetupColumn("now");
+        ImGui::TableSetupColumn("mean");
+        ImGui::TableSetupColumn("10-90%");
+        ImGui::TableSetupColumn("odds");
+        if(show_sampled)
+            ImGui::TableSetupColumn("sampled");
+        ImGui::TableHeadersRow();
+
+        for(int s = 0; s < GROWTH_STATS; ++s)
+        {
+            const StatProjection &stat = exact.stats[s];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", GrowthStats[s].name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", unit.*GrowthStats[s].stat);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", stat.Mean());
+            ImGui::TableNextColumn();
+            ImGui::Text("%d-%d", stat.Percentile(0.1), stat.Percentile(0.9));
+            ImGui::TableNextColumn();
+            vector<float> odds(stat.odds.begin(), stat.odds.end());
+            ImGui::PushID(s);
+            ImGui::PlotHistogram("", odds.data(), (int)odds.size(), 0, nullptr,
+                                 0.0f, 1.0f, ImVec2(100, 16));
+            ImGui::PopID();
+            if(show_sampled)
+            {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", sampled.stats[s].Mean());
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
 static uint8_t selectedIndex = 0;
 static bool editing_allies = false;
 void
@@ -70,11 +154,11 @@ UnitEditor(vector<shared_ptr<Unit>> *units)
                 ITEM_NONE,
                 ITEM_NONE,
 
-                Spritesheet(LoadTextureImage(SPRITES_PATH, string(DEFAULT_SHEET)), 32, ANIMATION_SPEED),
-                LoadTextureImage(FULLS_PATH, string(DEFAULT_PORTRAIT)),
-                LoadTextureImage(FULLS_PATH, string(DEFAULT_PORTRAIT)),
-                LoadTextureImage(FULLS_PATH, string(DEFAULT_PORTRAIT)),
-                LoadTextureImage(FULLS_PATH, string(DEFAULT_PORTRAIT))
+                LoadSpritesheet(SPRITES_PATH, DEFAULT_SHEET, 32, ANIMATION_SPEED),
+                TextureReference(FULLS_PATH, string(DEFAULT_PORTRAIT)),
+                TextureReference(FULLS_PATH, string(DEFAULT_PORTRAIT)),
+                TextureReference(FULLS_PATH, string(DEFAULT_PORTRAIT)),
+                TextureReference(FULLS_PATH, string(DEFAULT_PORTRAIT))
             ));
         }
         ImGui::SameLine();
@@ -122,7 +206,11 @@ UnitEditor(vector<shared_ptr<Unit>> *units)
         ImGui::SliderInt("magic", (int *)&selected->growths.magic, 0, 100);
         ImGui::SliderInt("speed", (int *)&selected->growths.speed, 0, 100);
         ImGui::SliderInt("skill", (int *)&selected->growths.skill, 0, 100);
+        ImGui::SliderInt("luck", (int *)&selected->growths.luck, 0, 100);
         ImGui::SliderInt("defense", (int *)&selected->growths.defense, 0, 100);
+        ImGui::SliderInt("resistance", (int *)&selected->growths.resistance, 0, 100);
+
+        GrowthProjector(*selected);
 
         ImGui::Text("ability: %d", selected->ability);
         ImGui::SameLine();
@@ -170,6 +258,11 @@ UnitEditor(vector<shared_ptr<Unit>> *units)
             if(item_type != 0)
                 selected->secondary_item = GetItem((ItemType)item_type);
         }
+
+        // The sliders and buttons above write straight into the unit, name
+        // included, so its key and derived stats are both redone from scratch.
+        selected->Rehash();
+        selected->Derive();
     }
     ImGui::End();
 }
@@ -303,6 +396,8 @@ void LevelEditor(Level *level, const vector<shared_ptr<Unit>> &units)
             *hover_tile = CHEST_TILE;
             hover_tile->occupant = tmp;
         }
+        // Cheap enough to just do every frame, and catches every button above.
+        level->map.RehashTerrain();
 
 
         ImGui::Text("Units:");
@@ -311,10 +406,7 @@ void LevelEditor(Level *level, const vector<shared_ptr<Unit>> &units)
             if(!(hover_tile->occupant ||
                  hover_tile->type == WALL))
             {
-                level->combatants.push_back(make_shared<Unit>(*units[selectedIndex]));
-                level->combatants.back()->pos.col = editor_cursor.col;
-                level->combatants.back()->pos.row = editor_cursor.row;
-                hover_tile->occupant = level->combatants.back().get();
+                level->AddCombatant(make_shared<Unit>(*units[selectedIndex]), editor_cursor);
             }
             else
             {
@@ -355,7 +447,7 @@ void LevelEditor(Level *level, const vector<shared_ptr<Unit>> &units)
         {
             ImGui::Text("Over unit.");
             ImGui::SameLine();
-            ImGui::Text("Behavior: %d", hover_tile->occupant->ai_behavior);
+            ImGui::Text("Behavior: %s", GetBehaviorString(hover_tile->occupant->ai_behavior).c_str());
             ImGui::SameLine();
             ImGui::Checkbox("boss?", &hover_tile->occupant->is_boss);
 
@@ -453,6 +545,224 @@ GlobalsViewer()
         ImGui::Checkbox("GlobalEditorMode", &GlobalEditorMode);
         ImGui::Text("%02d | STATE", GlobalInterfaceState);
         ImGui::Text("%02d | AI", GlobalAIState);
+        ImGui::Text("Seed | battle %llu | next %llu",
+                    (unsigned long long)GlobalRng.seed,
+                    (unsigned long long)GlobalRng.next_battle);
+
+        ImGui::Text("AI Mode");
+        ImGui::RadioButton("greedy", (int *)&GlobalAIMode, AI_MODE_GREEDY);
+        ImGui::SameLine();
+        ImGui::RadioButton("rollout", (int *)&GlobalAIMode, AI_MODE_ROLLOUT);
+
+        ImGui::Text("Enemy Phase");
+        for(int speed = PHASE_SPEED_1X; speed <= PHASE_SPEED_INSTANT; ++speed)
+        {
+            if(speed != PHASE_SPEED_1X)
+                ImGui::SameLine();
+            ImGui::RadioButton(GetPhaseSpeedString((PhaseSpeed)speed).c_str(),
+                               (int *)&GlobalPhaseSpeed, speed);
+        }
+
+        ImGui::Text("Clock | sim %.3f ms/tick | render %.3f ms/frame",
+                    GlobalClock.sim_ms, GlobalClock.render_ms);
+        ImGui::SliderFloat("sim speed", &GlobalClock.speed, 0.1f, 4.0f);
+
+        ImGui::Text("AI Cache | moves %d/%d | actions %d/%d",
+                    GlobalMovementCache.hits, GlobalMovementCache.hits + GlobalMovementCache.misses,
+                    GlobalActionCache.hits, GlobalActionCache.hits + GlobalActionCache.misses);
+        if(ImGui::Button("clear ai cache"))
+        {
+            GlobalMovementCache.Clear();
+            GlobalActionCache.Clear();
+        }
+        ImGui::Text("Influence | %d footprints | %d redrawn last refresh",
+                    (int)GlobalInfluence.footprints.size(), GlobalInfluence.redrawn);
+    }
+    ImGui::End();
+}
+
+// Where the last few hundred AI decisions spent their time.
+void
+AIProfilerViewer()
+{
+    static const ImU32 section_colors[PROFILE_SECTIONS] = {
+        IM_COL32(128, 128, 128, 255), // other
+        IM_COL32( 66, 135, 245, 255), // movement
+        IM_COL32(245, 166,  35, 255), // attack squares
+        IM_COL32(126, 211,  33, 255), // nearest
+        IM_COL32(208,   2,  27, 255), // paths
+        IM_COL32(144,  19, 254, 255), // influence
+        IM_COL32( 80, 227, 194, 255), // scoring
+        IM_COL32(248, 231,  28, 255), // rollout
+    };
+    static string exported = "";
+
+    ImGui::Begin("AI Profiler");
+    {
+        const AIProfiler &profiler = GlobalAIProfiler;
+
+        if(ImGui::Button("clear"))
+            GlobalAIProfiler.Clear();
+        ImGui::SameLine();
+        if(ImGui::Button("export"))
+            exported = profiler.Export();
+        if(!exported.empty())
+        {
+            ImGui::SameLine();
+            ImGui::Text("%s", exported.c_str());
+        }
+
+        // Totals over everything remembered.
+        double totals[PROFILE_SECTIONS] = {};
+        double slowest = 1.0;
+        for(int i = 0; i < profiler.count; ++i)
+        {
+            const AIDecisionProfile &decision = profiler.Get(i);
+            for(int section = 0; section < PROFILE_SECTIONS; ++section)
+                totals[section] += decision.section_us[section];
+            slowest = max(slowest, decision.Total());
+        }
+        for(int section = 0; section < PROFILE_SECTIONS; ++section)
+        {
+            if(section % 4)
+                ImGui::SameLine();
+            ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(section_colors[section]),
+                               "%s %.1f ms",
+                               GetProfileSectionString((ProfileSection)section).c_str(),
+                               totals[section] / 1000.0);
+        }
+
+        // Timeline | One stacked bar per decision, oldest on the left.
+        ImGui::Text("Timeline | slowest %.0f us", slowest);
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImVec2 size = {ImGui::GetContentRegionAvail().x, 80.0f};
+        ImDrawList *draw_list = ImGui::GetWindowDrawList();
+        draw_list->AddRectFilled(origin, {origin.x + size.x, origin.y + size.y},
+                                 IM_COL32(20, 20, 20, 255));
+        float bar_width = size.x / AI_PROFILE_ENTRIES;
+        for(int i = 0; i < profiler.count; ++i)
+        {
+            const AIDecisionProfile &decision = profiler.Get(i);
+            float x = origin.x + i * bar_width;
+            float y = origin.y + size.y;
+            for(int section = 0; section < PROFILE_SECTIONS; ++section)
+            {
+                float height = (float)(decision.section_us[section] / slowest) * size.y;
+                draw_list->AddRectFilled({x, y - height}, {x + max(bar_width - 1.0f, 1.0f), y},
+                                         section_colors[section]);
+                y -= height;
+            }
+        }
+        ImGui::Dummy(size);
+
+        // Table | Newest first.
+        if(ImGui::BeginTable("decisions", 5 + PROFILE_SECTIONS,
+                             ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                             ImGuiTableFlags_ScrollY | ImGuiTableFlags_ScrollX,
+                             {0.0f, 300.0f}))
+        {
+            ImGui::TableSetupScrollFreeze(1, 1);
+            ImGui::TableSetupColumn("unit");
+            ImGui::TableSetupColumn("turn");
+            ImGui::TableSetupColumn("total us");
+            for(int section = 0; section < PROFILE_SECTIONS; ++section)
+                ImGui::TableSetupColumn(GetProfileSectionString((ProfileSection)section).c_str());
+            ImGui::TableSetupColumn("nodes");
+            ImGui::TableSetupColumn("candidates");
+            ImGui::TableHeadersRow();
+
+            for(int i = profiler.count - 1; i >= 0; --i)
+            {
+                const AIDecisionProfile &decision = profiler.Get(i);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s%s", decision.unit.c_str(), decision.cached ? " (cached)" : "");
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", decision.turn);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.0f", decision.Total());
+                for(int section = 0; section < PROFILE_SECTIONS; ++section)
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.0f", decision.section_us[section]);
+                }
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", decision.nodes);
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", decision.candidates);
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+// What's in video memory, from GlobalTextureCache.
+void
+TextureViewer()
+{
+    ImGui::Begin("Textures");
+    {
+        const TextureCache &cache = GlobalTextureCache;
+        ImGui::Text("%.2f MB in %d resident | cache %d/%d",
+                    cache.TotalBytes() / (1024.0 * 1024.0), (int)cache.resident.size(),
+                    cache.hits, cache.hits + cache.misses);
+        ImGui::Text("Decoding %d | %d requested | %.2f ms uploading this frame",
+                    (int)cache.decoding.size(), cache.requests, cache.upload_ms);
+        ImGui::Text("Atlas | %d sheets on %d pages", (int)GlobalSpriteAtlas.regions.size(),
+                    (int)GlobalSpriteAtlas.pages.size());
+        for(int category = 0; category < TEXTURE_CATEGORIES; ++category)
+        {
+            ImGui::Text("%-9s %4d | %8.1f KB",
+                        GetTextureCategoryString((TextureCategory)category).c_str(),
+                        cache.count[category], cache.bytes[category] / 1024.0);
+        }
+
+        PortraitCache &portraits = GlobalPortraits;
+        ImGui::Text("Portraits | %d held, %.1f MB | %d loads, %d hits, %d let go",
+                    (int)portraits.entries.size(), portraits.bytes / (1024.0 * 1024.0),
+                    portraits.loads, portraits.hits, portraits.evictions);
+        int budget_mb = (int)(portraits.budget / (1024 * 1024));
+        if(ImGui::SliderInt("portrait budget MB", &budget_mb, 8, 256))
+        {
+            portraits.budget = (int64_t)budget_mb * 1024 * 1024;
+            portraits.Trim();
+        }
+
+        // Images only. Text comes and goes too often to be worth listing.
+        vector<shared_ptr<TextureResource>> images = {};
+        for(const auto &entry : cache.resident)
+            if(shared_ptr<TextureResource> image = entry.second.lock())
+                images.push_back(image);
+        sort(images.begin(), images.end(),
+             [](const shared_ptr<TextureResource> &a, const shared_ptr<TextureResource> &b)
+             { return a->bytes > b->bytes; });
+
+        if(ImGui::BeginTable("resident", 4,
+                             ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                             ImGuiTableFlags_ScrollY, {0.0f, 300.0f}))
+        {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("image");
+            ImGui::TableSetupColumn("size");
+            ImGui::TableSetupColumn("KB");
+            ImGui::TableSetupColumn("held by");
+            ImGui::TableHeadersRow();
+
+            for(const shared_ptr<TextureResource> &image : images)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", image->key.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%dx%d", image->width, image->height);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", image->bytes / 1024.0);
+                ImGui::TableNextColumn();
+                ImGui::Text("%ld", image.use_count() - 1); // Not counting this list.
+            }
+            ImGui::EndTable();
+        }
     }
     ImGui::End();
 }
@@ -468,6 +778,8 @@ EditorPass(vector<shared_ptr<Unit>> *units,
     static bool showUnitEditor = true;
     static bool showLevelEditor = true;
     static bool showGlobals = false;
+    static bool showProfiler = false;
+    static bool showTextures = false;
     static bool showMeta = true;
 
     static char fileName[128] = INITIAL_UNITS;
@@ -498,6 +810,42 @@ EditorPass(vector<shared_ptr<Unit>> *units,
             cout << "Level saved: " << levelFileName << "\n";
         }
 
+        // Quicksave. Kept in memory too, so loading it back doesn't touch the disk.
+        static Snapshot quicksave;
+        static float snapshot_ms = 0.0f;
+        if(ImGui::Button("Quicksave"))
+        {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            TakeSnapshot(*level, &quicksave);
+            snapshot_ms = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+            SaveSnapshot(SAVES_PATH + string(QUICKSAVE_FILE), quicksave);
+        }
+        ImGui::SameLine();
+        if(ImGui::Button("Quickload"))
+        {
+            if(quicksave.bytes.empty())
+                LoadSnapshot(SAVES_PATH + string(QUICKSAVE_FILE), &quicksave);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            RestoreSnapshot(quicksave, level, *units, party);
+            if(GlobalJournal)
+                GlobalJournal->Clear();
+            snapshot_ms = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+        }
+        ImGui::SameLine();
+        ImGui::Text("%d bytes | %.3f ms", (int)quicksave.bytes.size(), snapshot_ms);
+
+        if(GlobalJournal)
+        {
+            if(ImGui::Button("Rewind"))
+                GlobalJournal->Rewind();
+            ImGui::SameLine();
+            if(ImGui::Button("Rewind Turn"))
+                GlobalJournal->RewindTurn();
+            ImGui::SameLine();
+            ImGui::Text("%d actions | %d turns",
+                        (int)GlobalJournal->entries.size(), (int)GlobalJournal->turn_starts.size());
+        }
+
         if(ImGui::Button("Test Zone"))
         {
             *level = LoadLevel(DATA_PATH + string("test.txt"), *units, party);
@@ -528,6 +876,10 @@ EditorPass(vector<shared_ptr<Unit>> *units,
         ImGui::Checkbox("Unit Editor", &showUnitEditor);
         ImGui::Checkbox("Level Editor", &showLevelEditor);
         ImGui::Checkbox("Globals", &showGlobals);
+        ImGui::SameLine();
+        ImGui::Checkbox("AI Profiler", &showProfiler);
+        ImGui::SameLine();
+        ImGui::Checkbox("Textures", &showTextures);
         ImGui::Checkbox("Meta", &showMeta);
 
         ImGui::Text("avg %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
@@ -540,6 +892,10 @@ EditorPass(vector<shared_ptr<Unit>> *units,
         LevelEditor(level, *units);
     if(showGlobals)
         GlobalsViewer();
+    if(showProfiler)
+        AIProfilerViewer();
+    if(showTextures)
+        TextureViewer();
     if(showMeta)
         Meta(level);
 
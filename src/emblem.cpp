@@ -123,105 +123,156 @@ EmitEvent(Event event)
 #include "constants.h"
 static InterfaceState GlobalInterfaceState;
 static AIState GlobalAIState;
+static AIMode GlobalAIMode = AI_MODE_GREEDY;
+static PhaseSpeed GlobalPhaseSpeed = PHASE_SPEED_1X;
 
 #include "utils.h"
+#include "jobs.h"
+#include "profiler.h"
 #include "animation.h"
 #include "audio.h" // NOTE: Includes GlobalMusic and GlobalSfx, GlobalSong
 #include "item.h"
+#include "texture.h"
 #include "structs.h"
+#include "atlas.h"
+#include "growth.h"
 #include "vfx.h"
 #include "event.h" // NOTE: Includes a GlobalEvents queue.
 #include "cursor.h"
+#include "parse.h"
 #include "load.h"
+#include "compile.h"
+#include "portrait.h"
 #include "init.h"
 #include "input.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "journal.h"
 #include "grid.h"
 #include "fight.h"
+#include "predict.h"
 #include "ui.h"
 #include "command.h"
+#include "transposition.h"
+#include "influence.h"
+#include "rollout.h"
 #include "ai.h"
 #include "render.h"
 #include "editor.h"
 
 
+// NOTE: Tools in src/tools/ include this whole file and bring their own main.
+#ifndef EMBLEM_TOOL
 int main(int argc, char *argv[])
 {
-    srand(time(NULL));
+    // --seed <n>      | Seeds the first battle played. The rest follow from it.
+    // --level <n>     | Starts at that campaign level, with the party in units.tsv.
+    //                 | With --seed, replays the battle that printed them both.
+    // --frames <n>    | Quits after that many frames. For benchmarks and CI.
+    // --record <file> | Writes every frame's input out, to be replayed.
+    // --replay <file> | Plays a recording back, then quits. Brings its own seed.
+    // --speed <x>     | Runs the sim x times as fast as real time.
+    // --resume <file> | Picks a battle back up from a snapshot, like the autosave.
+    uint64_t seed = (uint64_t)time(NULL);
+    int start_level = 0;
+    int frame_limit = 0;
+    string record_file = "";
+    string resume_file = "";
+    InputReplay replay;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if(!strcmp(argv[i], "--level") && i + 1 < argc)
+            start_level = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frame_limit = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--speed") && i + 1 < argc)
+            GlobalClock.speed = (float)atof(argv[++i]);
+        else if(!strcmp(argv[i], "--record") && i + 1 < argc)
+            record_file = argv[++i];
+        else if(!strcmp(argv[i], "--resume") && i + 1 < argc)
+            resume_file = argv[++i];
+        else if(!strcmp(argv[i], "--replay") && i + 1 < argc)
+        {
+            if(!replay.Load(argv[++i]))
+                return 1;
+        }
+        else
+            cout << "WARN main: Unknown argument " << argv[i] << "\n";
+    }
+    if(replay.playing)
+    {
+        seed = replay.seed;
+        GlobalAIMode = replay.ai_mode;
+        if(GlobalAIMode == AI_MODE_ROLLOUT)
+            cout << "WARN main: Replay used the rollout planner. It may not play back the same.\n";
+    }
+    GlobalRng.Begin(seed);
+    if(HEADLESS && !frame_limit && !replay.playing)
+        cout << "WARN main: Headless without --frames or --replay. Runs until it's killed.\n";
+
+    InputRecorder recorder;
+    if(!record_file.empty())
+        recorder.Open(record_file, seed, GlobalAIMode);
 
     if(!Initialize())
         SDL_assert(!"Initialization Failed\n");
 
+    GlobalJobs.Start();
+
     // controller init
     SDL_Joystick *gamepad = NULL;
-    if(SDL_NumJoysticks() > 0)
+    if(!HEADLESS && SDL_NumJoysticks() > 0)
     {
         gamepad = SDL_JoystickOpen(0);
         SDL_assert(gamepad);
     }
 
-    GlobalMusic.sounds =
-    {
-        new Sound("spiny.wav", MUSIC),
-        new Sound("r4.wav", MUSIC),
-        new Sound("qc.wav", MUSIC),
-        new Sound("6.wav", MUSIC),
-        new Sound("13.wav", MUSIC),
-        new Sound("21.wav", MUSIC),
-        new Sound("tripod.wav", MUSIC),
-        new Sound("fs.wav", MUSIC),
-        new Sound("spacelion.wav", MUSIC),
-        new Sound("fire.wav", MUSIC),
-        new Sound("boat.wav", MUSIC),
-        new Sound("forest.wav", MUSIC),
-        new Sound("town.wav", MUSIC),
-        new Sound("gerudo.wav", MUSIC),
-        new Sound("village.wav", MUSIC),
-        new Sound("hamduche.wav", MUSIC),
-        new Sound("wind.wav", MUSIC),
-        new Sound("chrono.wav", MUSIC),
-        new Sound("title.wav", MUSIC)
-    };
-
-    GlobalSfx.sounds =
-    {
-        new Sound("mov.wav", SFX),
-        new Sound("crit.wav", SFX),
-        new Sound("heal.wav", SFX),
-        new Sound("hit1.wav", SFX),
-        new Sound("hit2.wav", SFX),
-        new Sound("hit3.wav", SFX),
-        new Sound("magic.wav", SFX),
-        new Sound("miss.wav", SFX),
-        new Sound("pickup.wav", SFX),
-        new Sound("place.wav", SFX),
-        new Sound("powerup.wav", SFX),
-        new Sound("ranged.wav", SFX),
-        new Sound("sel1.wav", SFX),
-        new Sound("sel2.wav", SFX),
-        new Sound("sel3.wav", SFX),
-        new Sound("start.wav", SFX),
-        new Sound("dance.wav", SFX)
-    };
+    LoadSounds();
 
 // ================================== load =================================
+    // The title screen's up, and answering, while the sprites decode on the
+    // workers. What's left to load on this thread after that is quick.
+    vector<string> sprites = UnitSprites(DATA_PATH + string(INITIAL_UNITS));
+    sprites.push_back("cursor.png");
+    for(const string &sprite : sprites)
+        GlobalTextureCache.Request(SPRITES_PATH, sprite);
+
+    GlobalRunning = true;
+    while(!HEADLESS && GlobalRunning && GlobalTextureCache.Pending())
+    {
+        SDL_Event event;
+        while(SDL_PollEvent(&event))
+            if(event.type == SDL_QUIT)
+                GlobalRunning = false;
+        SDL_SetRenderDrawColor(GlobalRenderer, backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a);
+        SDL_RenderClear(GlobalRenderer);
+        SDL_RenderPresent(GlobalRenderer); // NOTE: Waits on vsync.
+    }
+
+    // Every unit's sheet and the cursor, on as few textures as they fit on.
+    GlobalSpriteAtlas.Pack(SPRITES_PATH, sprites);
+
     vector<shared_ptr<Unit>> units = LoadUnits(DATA_PATH + string(INITIAL_UNITS));
     vector<shared_ptr<Unit>> party = {};
 
 
-    vector<string> levels = {string("l0.txt"), string("l1.txt"),
-                             string("l2.txt"), string("l3.txt"),
-                             string("l4.txt"), string("l5.txt"),
-                             string("l6.txt"), string("l7.txt")
-							 };
+    vector<string> levels = CampaignLevels();
     int level_index = 0;
+    if(start_level < 0 || start_level >= levels.size())
+        cout << "WARN main: No level " << start_level << ". There are " << levels.size() << ".\n";
+    else if(start_level && (recorder.recording || replay.playing))
+        cout << "WARN main: Recordings start from the first level. Ignoring --level.\n";
+    else
+        level_index = start_level;
     Level level = LoadLevel(DATA_PATH + levels[level_index], units, party);
 
-    Cursor cursor(Spritesheet(LoadTextureImage(SPRITES_PATH, string("cursor.png")), 
-		32, ANIMATION_SPEED));
+    Cursor cursor(LoadSpritesheet(SPRITES_PATH, "cursor.png", 32, ANIMATION_SPEED));
 
 	UI_State ui = {};
 
-    Menu game_menu({"Outlook", "Options", "End Turn"});
+    Menu game_menu({"Outlook", "Options", "End Turn", "Rewind"});
     Menu unit_menu({"Wait"});
     Menu level_menu({"Next", "Redo", "Conv"});
     Menu conversation_menu({"Return"});
@@ -235,135 +286,182 @@ int main(int argc, char *argv[])
     AI ai;
 
     Fight fight;
+    CombatLog combat_log;
 
     GlobalInterfaceState = TITLE_SCREEN;
     GlobalAIState = PLAYER_TURN;
 
-    GlobalRunning = true;
-// ========================= game loop =========================================
-    while(GlobalRunning)
+    Snapshot autosave;
+    bool played_a_turn = false; // This session. See the autosave below.
+    if(!resume_file.empty())
     {
-        HandleEvents(&input, gamepad);
-
-        // Update
-        if(!GlobalEditorMode)
+        if(recorder.recording || replay.playing)
+            cout << "WARN main: Recordings start from the level, not the snapshot.\n";
+        if(LoadSnapshot(resume_file, &autosave) &&
+           RestoreSnapshot(autosave, &level, units, party))
         {
-            handler.Update(&input);
-            handler.UpdateCommands(&cursor, &level, units, party,
-                                   &game_menu, &unit_menu, 
-                                   &level_menu, &conversation_menu,
-                                   &fight);
+            for(int i = 0; i < levels.size(); ++i)
+                if(level.name == DATA_PATH + levels[i])
+                    level_index = i;
+            cursor.PlaceAt(level.Leader());
+            SetViewport(cursor.pos, level.map.width, level.map.height);
+            cout << "Resumed " << level.name << " from " << resume_file << "\n";
+        }
+    }
 
-            ai.Update(&cursor, &level.map, &fight);
+    Journal journal;
+    journal.level = &level;
+    journal.Clear();
+    GlobalJournal = &journal;
 
-            cursor.Update(&level.map);
-            fight.Update();
-            parcel.Update();
-            level.Update();
-            level_fade.Update();
-            turn_fade.Update();
+    int frame = 0;
+    int ticks_run = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+// ========================= game loop =========================================
+    while(GlobalRunning)
+    {
+        // Input comes in once a frame. The sim then catches up to real time
+        // in fixed ticks, however many that takes. Headless and replays go in
+        // lockstep instead, a tick a frame, as fast as they can.
+        if(!replay.playing && !HEADLESS)
+            HandleEvents(&input, gamepad);
+        int ticks = (HEADLESS || replay.playing) ? 1 : GlobalClock.Advance();
+
+        GlobalClock.BeginSim();
+        for(int tick = 0; tick < ticks; ++tick)
+        {
+            if(replay.playing && !replay.Feed(&input))
+            {
+                GlobalRunning = false;
+                break;
+            }
+            recorder.Record(input);
+            if(input.joystickCooldown)
+                --input.joystickCooldown;
+            ++ticks_run;
 
+            // Where things were drawn last tick, to draw in between.
+            cursor.last_offset = cursor.animation_offset;
             for(const shared_ptr<Unit> &unit : level.combatants)
-                unit->Update();
-
-            for(Sound *sound : GlobalMusic.sounds)
-                sound->Update();
+                unit->last_offset = unit->animation_offset;
 
-            if(GlobalInterfaceState == NEUTRAL_OVER_DEACTIVATED_UNIT &&
-               ((level.objective == OBJECTIVE_ROUT &&
-                 level.GetNumberOf(false) == 0)
-                 ||
-                (level.objective == OBJECTIVE_BOSS && 
-                 level.IsBossDead())))
+            // Update
+            if(!GlobalEditorMode)
             {
-                cout << "IN CONDITION\n";
-                level.song->FadeOut();
-                GlobalInterfaceState = LEVEL_MENU;
-            }
-        }
+                if(Journal::AtRest())
+                    journal.Mark();
+                handler.Update(&input);
+                handler.UpdateCommands(&cursor, &level, units, party,
+                                       &game_menu, &unit_menu, 
+                                       &level_menu, &conversation_menu,
+                                       &fight);
+
+                // Fast-forward just runs the enemy phase several steps a frame.
+                int steps = GlobalPlayerTurn ? 1 : PhaseSpeedSteps(GlobalPhaseSpeed);
+                for(int step = 0; step < steps; ++step)
+                {
+                    if(step && Journal::AtRest())
+                        journal.Mark();
+                    ai.Update(&cursor, &level, &fight, &combat_log);
 
-        // Resolve State
-        //////////////// TO BE EXTRICATED //////////////////
-        if(GlobalNextLevel)
-        {
-            GlobalNextLevel = false;
+                    cursor.Update(&level.map);
+                    fight.Update();
+                    parcel.Update();
+                    level.Update();
 
-            level_index = (level_index + 1 < levels.size()) ? level_index + 1 : 0;
+                    for(const shared_ptr<Unit> &unit : level.combatants)
+                        unit->Update();
 
-            party = {};
-            for(shared_ptr<Unit> unit : level.combatants)
-            {
-            // Reset the party's statistics
-                if(unit->is_ally)
+                    if(GlobalPlayerTurn)
+                        break;
+                }
+                level_fade.Update();
+                turn_fade.Update();
+                combat_log.Update();
+
+                for(Sound *sound : GlobalMusic.sounds)
+                    sound->Update();
+
+                if(GlobalInterfaceState == NEUTRAL_OVER_DEACTIVATED_UNIT &&
+                   ((level.objective == OBJECTIVE_ROUT &&
+                     level.GetNumberOf(false) == 0)
+                     ||
+                    (level.objective == OBJECTIVE_BOSS && 
+                     level.IsBossDead())))
                 {
-                    unit->health = unit->max_health;
-                    if(unit->buff)
-                        delete unit->buff;
-                        unit->buff = nullptr;
-                    unit->turns_active = -1;
-                    unit->is_exhausted = false;
-                    party.push_back(unit);
+                    cout << "IN CONDITION\n";
+                    level.song->FadeOut();
+                    GlobalInterfaceState = LEVEL_MENU;
                 }
             }
 
-            level.song->Stop();
-            level = LoadLevel(DATA_PATH + levels[level_index], units, party);
-            level.conversations.prelude.song->Start();
+            // Resolve State
+            //////////////// TO BE EXTRICATED //////////////////
+            if(GlobalNextLevel)
+            {
+                GlobalNextLevel = false;
 
-            GlobalPlayerTurn = true;
-            GlobalTurnStart = true;
-        }
-        if(GlobalTurnStart)
-        {
-            GlobalTurnStart = false;
+                level_index = (level_index + 1 < levels.size()) ? level_index + 1 : 0;
 
-            if(GlobalPlayerTurn)
-            {
-                for(auto const &unit : level.combatants)
-                {
-                    if(!unit->is_ally) // Increment enemy units
-                    {
-                        ++unit->turns_active;
-                    }
-                    if(unit->buff)
-                        unit->TickBuff();
-                }
+                party = CarryParty(level);
+
+                level.song->Stop();
+                level = LoadLevel(DATA_PATH + levels[level_index], units, party);
+                level.conversations.prelude.song->Start();
+
+                GlobalPlayerTurn = true;
+                GlobalTurnStart = true;
             }
-            else
+            if(GlobalTurnStart)
             {
-                for(auto const &unit : level.combatants)
+                journal.StartTurn();
+                GlobalTurnStart = false;
+                level.StartPhase(GlobalPlayerTurn);
+
+                cursor.PlaceAt(level.Leader());
+                SetViewport(cursor.pos, level.map.width, level.map.height);
+
+                // TODO: This is pretty bad. Just work out how the logic should actually go.
+                if(GlobalInterfaceState != PRELUDE)
+                    GlobalInterfaceState = NEUTRAL_OVER_UNIT;
+
+                ai.clearQueue();
+                handler.clearQueue();
+
+#if !HEADLESS
+                // Once a player turn, so a crash costs that turn at most. Not
+                // until one's been played, though, or just starting the game
+                // up would write over the last session's.
+                if(!GlobalPlayerTurn)
+                    played_a_turn = true;
+                if(GlobalPlayerTurn && played_a_turn)
                 {
-                    if(unit->is_ally)
-                    {
-                        ++unit->turns_active;
-                    }
+                    TakeSnapshot(level, &autosave);
+                    SaveSnapshot(SAVES_PATH + string(AUTOSAVE_FILE), autosave);
                 }
+#endif
             }
 
-            for(auto const &unit : level.combatants)
-                unit->Activate();
-
-            cursor.PlaceAt(level.Leader());
-            SetViewport(cursor.pos, level.map.width, level.map.height);
-
-            // TODO: This is pretty bad. Just work out how the logic should actually go.
-            if(GlobalInterfaceState != PRELUDE)
-                GlobalInterfaceState = NEUTRAL_OVER_UNIT;
-
-            ai.clearQueue();
-            handler.clearQueue();
+            // TODO : Definitely get rid of this.
+            if(GlobalInterfaceState == GAME_OVER)
+            {
+                GlobalPlayerTurn = true;
+                ai.clearQueue();
+            }
+            //////////////// ABOVE TO BE EXTRICATED //////////////////
+            GlobalHandleEvents(&level_fade, &turn_fade, &parcel);
         }
+        GlobalClock.EndSim(ticks);
 
-        // TODO : Definitely get rid of this.
-        if(GlobalInterfaceState == GAME_OVER)
-        {
-            GlobalPlayerTurn = true;
-            ai.clearQueue();
-        }
-        //////////////// ABOVE TO BE EXTRICATED //////////////////
-        GlobalHandleEvents(&level_fade, &turn_fade, &parcel);
+        ++frame;
+        if(frame_limit && frame >= frame_limit)
+            GlobalRunning = false;
 
+#if !HEADLESS
         // Render
+        GlobalClock.BeginRender();
+        GlobalTextureCache.BeginFrame();
+        GlobalPortraits.Update();
         Render(level.map, cursor, game_menu, unit_menu, level_menu, conversation_menu,
                level.conversations, fight, level_fade, turn_fade);
 
@@ -371,7 +469,7 @@ int main(int argc, char *argv[])
 		ImGui_ImplSDLRenderer_NewFrame();
 		ImGui_ImplSDL2_NewFrame();
 		ImGui::NewFrame();
-        RenderUI(&ui, cursor, level, fight, parcel);
+        RenderUI(&ui, cursor, level, fight, parcel, combat_log);
 
 #if DEV_MODE
         if(GlobalEditorMode)
@@ -383,16 +481,33 @@ int main(int argc, char *argv[])
 		ImGui_ImplSDLRenderer_RenderDrawData(ImGui::GetDrawData());
 
         SDL_RenderPresent(GlobalRenderer);
+        GlobalClock.EndRender();
+#endif
 
     } // End Game Loop
 
+    recorder.Close();
+    if(frame_limit || replay.ticks || recorder.ticks)
+    {
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Ran " << frame << " frames, " << ticks_run << " ticks in " << seconds
+             << " s (" << (seconds > 0.0 ? frame / seconds : 0.0) << " frames/s)\n";
+        cout << "Sim " << GlobalClock.sim_ms << " ms/tick, render "
+             << GlobalClock.render_ms << " ms/frame\n";
+        // The same recording should always end on the same board.
+        cout << "Board hash: " << hex << level.map.Hash() << dec << "\n";
+    }
+
     // This needs to be in this function due to scope restrictions.
     // TODO: Learn more about heap allocation, scope weirdness, double frees, etc.
-    for(Sound *sound : GlobalMusic.sounds)
-        delete sound;
-    for(Sound *sound : GlobalSfx.sounds)
-        delete sound;
+    UnloadSounds();
+
+    // Decodes nobody's waiting on are dropped, and the workers finish up,
+    // before SDL_image goes away under them.
+    GlobalTextureCache.CancelAll();
+    GlobalJobs.Stop();
 
     Close();
     return 0;
 }
+#endif
@@ -5,13 +5,15 @@
 #ifndef FIGHT_H
 #define FIGHT_H
 
+#include <unordered_map>
+
 // Returns the chance to hit a unit
 int
 HitChance(const Unit &predator, const Unit &prey, int bonus)
 {
-    int hit = predator.Hit();
+    int hit = predator.derived.hit;
 
-    int avoid = prey.Avoid() + bonus;
+    int avoid = prey.derived.avoid + bonus;
 
     return (hit - avoid - bonus);
 }
@@ -21,20 +23,15 @@ HitChance(const Unit &predator, const Unit &prey, int bonus)
 int
 CritChance(const Unit &predator, const Unit &prey)
 {
-    return (predator.Crit());
+    return (predator.derived.crit);
 }
 
 // Determines what damage a hit will do.
 int
 CalculateDamage(const Unit &predator, const Unit &prey, int defense_bonus)
 {
-    int attack = predator.Attack();
-
-    int defense = prey.defense + defense_bonus;
-    if(predator.buff && predator.buff->stat == STAT_ATTACK)
-        attack += predator.buff->amount;
-    if(prey.buff && prey.buff->stat == STAT_DEFENSE)
-        defense += prey.buff->amount;
+    int attack = predator.derived.buffed_attack;
+    int defense = prey.derived.buffed_defense + defense_bonus;
     return clamp(attack - defense, 0, 999);
 }
 
@@ -42,22 +39,13 @@ CalculateDamage(const Unit &predator, const Unit &prey, int defense_bonus)
 bool
 Doubles(const Unit &predator, const Unit &prey)
 {
-    int pred_spd = predator.AttackSpeed();
-    int prey_spd = prey.AttackSpeed();
-    if(predator.buff && predator.buff->stat == STAT_SPEED)
-        pred_spd += predator.buff->amount;
-    if(prey.buff && prey.buff->stat == STAT_SPEED)
-        prey_spd += prey.buff->amount;
-    return pred_spd - prey_spd > DOUBLE_RATIO;
+    return predator.derived.buffed_speed - prey.derived.buffed_speed > DOUBLE_RATIO;
 }
 
 int
 CalculateHealing(const Unit &healer, const Unit &healee)
 {
-    int healing = healer.magic;
-    if(healer.buff && healer.buff->stat == STAT_SPEED)
-        healing += healer.buff->amount;
-    return healing;
+    return healer.magic + healer.BuffAmount(STAT_SPEED);
 }
 
 // Declares the outcome of a coming altercation.
@@ -91,21 +79,401 @@ PredictCombat(const Unit &one, const Unit &two, int distance,
     outcome.one_attacks = true;
     outcome.one_damage = CalculateDamage(one, two, two_defense_bonus);
     outcome.one_hit = HitChance(one, two, two_avoid_bonus);
-    outcome.one_crit = one.Crit();
+    outcome.one_crit = one.derived.crit;
     outcome.one_doubles = Doubles(one, two);
 
-    if(distance >= two.MinRange() && distance <= two.MaxRange())
+    if(distance >= two.derived.min_range && distance <= two.derived.max_range)
     {
         outcome.two_attacks = true;
         outcome.two_damage = CalculateDamage(two, one, one_defense_bonus);
         outcome.two_hit = HitChance(two, one, one_avoid_bonus);
-        outcome.two_crit = two.Crit();
+        outcome.two_crit = two.derived.crit;
         outcome.two_doubles = Doubles(two, one);
     }
 
     return outcome;
 }
 
+// ============================== Rolling Strikes ================================
+#define MAX_STRIKES 4
+
+// A single swing in a fight, as rolled.
+struct Strike
+{
+    bool by_one;
+    bool hit;
+    bool crit;
+};
+
+// Rolls the swings of a fight in order, stopping as soon as someone falls.
+// Shared by ResolveFight and the AI's simulations, so the two cannot drift.
+// roll(stream) must behave like d100(stream). Returns the number of strikes written.
+template <typename Roller>
+int
+RollStrikes(const Outcome &outcome, int one_health, int two_health,
+            Roller roll, Strike *strikes)
+{
+    int count = 0;
+    int one_accum = 0;
+    int two_accum = 0;
+
+    // Who swings, in order, and whether they get to.
+    const bool order[MAX_STRIKES] = {true, false, true, false};
+    const bool allowed[MAX_STRIKES] = {true,
+                                       outcome.two_attacks,
+                                       outcome.one_doubles,
+                                       outcome.two_attacks && outcome.two_doubles};
+
+    for(int i = 0; i < MAX_STRIKES; ++i)
+    {
+        if(!allowed[i])
+            continue;
+
+        bool by_one = order[i];
+        Strike strike = {by_one, false, false};
+        if(roll(RNG_HIT) < (by_one ? outcome.one_hit : outcome.two_hit))
+        {
+            strike.hit = true;
+            if(roll(RNG_CRIT) < (by_one ? outcome.one_crit : outcome.two_crit))
+                strike.crit = true;
+        }
+        strikes[count++] = strike;
+
+        if(!strike.hit)
+            continue;
+
+        int damage = by_one ? outcome.one_damage : outcome.two_damage;
+        if(strike.crit)
+            damage *= CRIT_MULTIPLIER;
+
+        if(by_one)
+        {
+            two_accum += damage;
+            if(two_health - two_accum <= 0)
+                break;
+        }
+        else
+        {
+            one_accum += damage;
+            if(one_health - one_accum <= 0)
+                break;
+        }
+    }
+
+    return count;
+}
+
+// Plays a fight out on bare health values, without any units or animations.
+// The fast path for simulations. Healths are clamped at zero, like Unit::Damage.
+template <typename Roller>
+void
+SimulateFight(const Outcome &outcome, int *one_health, int *two_health,
+              Roller roll)
+{
+    Strike strikes[MAX_STRIKES];
+    int count = RollStrikes(outcome, *one_health, *two_health, roll, strikes);
+    for(int i = 0; i < count; ++i)
+    {
+        if(!strikes[i].hit)
+            continue;
+
+        int damage = strikes[i].by_one ? outcome.one_damage : outcome.two_damage;
+        if(strikes[i].crit)
+            damage *= CRIT_MULTIPLIER;
+
+        int *health = strikes[i].by_one ? two_health : one_health;
+        *health = max(*health - damage, 0);
+    }
+}
+
+// ================================ Resolution =================================
+// Works a whole fight out up front, without touching the units, and writes
+// down what happened. The animated Fight plays the log back a swing at a
+// time. Skipping, instant phases and headless tools apply it all at once.
+// Either way it's the same fight.
+
+// One swing, and where it left both fighters.
+struct FightEvent
+{
+    bool by_one;
+    bool hit;
+    bool crit;
+    int damage;     // As dealt, crits included.
+    int one_health; // After the swing.
+    int two_health;
+};
+
+struct FightLog
+{
+    Outcome outcome = {};
+    int distance = 0;
+    int one_health = 0; // Before the fight.
+    int two_health = 0;
+
+    FightEvent events[MAX_STRIKES] = {};
+    int count = 0;
+
+    bool one_dies = false;
+    bool two_dies = false;
+    bool one_earns = false; // Whether one, rather than two, gets the experience.
+    int experience = 0;
+
+    int
+    OneHealthAfter() const
+    {
+        return count ? events[count - 1].one_health : one_health;
+    }
+
+    int
+    TwoHealthAfter() const
+    {
+        return count ? events[count - 1].two_health : two_health;
+    }
+};
+
+// How much experience the player's unit earns from a fight. When one is an
+// ally, it's the player's turn, and that's one. Otherwise it's two.
+int
+FightExperience(const Unit &one, const Unit &two, bool one_dies, bool two_dies)
+{
+    int experience_amount = 0;
+    if(one.is_ally)
+    {
+        experience_amount = EXP_FOR_COMBAT;
+        if(two_dies)
+            experience_amount += two.xp_value;
+
+        if(one.level > two.level)
+            experience_amount /= 2;
+    }
+    else
+    {
+        experience_amount = 1;
+        if(one_dies)
+            experience_amount += one.xp_value;
+
+        if(two.level > one.level + 3) // Arbitrary threshold
+            experience_amount /= 4;
+        else if(two.level > one.level)
+            experience_amount /= 2;
+    }
+    return experience_amount;
+}
+
+// roll(stream) must behave like d100(stream).
+template <typename Roller>
+FightLog
+ResolveFight(const Unit &one, const Unit &two, const Outcome &outcome, int distance,
+             Roller roll)
+{
+    FightLog log = {};
+    log.outcome = outcome;
+    log.distance = distance;
+    log.one_health = one.health;
+    log.two_health = two.health;
+
+    Strike strikes[MAX_STRIKES];
+    int count = RollStrikes(outcome, one.health, two.health, roll, strikes);
+
+    int one_health = one.health;
+    int two_health = two.health;
+    for(int i = 0; i < count; ++i)
+    {
+        FightEvent event = {strikes[i].by_one, strikes[i].hit, strikes[i].crit, 0, 0, 0};
+        if(event.hit)
+        {
+            event.damage = event.by_one ? outcome.one_damage : outcome.two_damage;
+            if(event.crit)
+                event.damage *= CRIT_MULTIPLIER;
+
+            // Same as Unit::Damage.
+            if(event.by_one)
+                two_health = clamp(two_health - event.damage, 0, two.max_health);
+            else
+                one_health = clamp(one_health - event.damage, 0, one.max_health);
+        }
+        event.one_health = one_health;
+        event.two_health = two_health;
+        log.events[log.count++] = event;
+    }
+
+    log.one_dies = one_health <= 0;
+    log.two_dies = two_health <= 0;
+    log.one_earns = one.is_ally;
+    log.experience = FightExperience(one, two, log.one_dies, log.two_dies);
+    return log;
+}
+
+// The same, with the distance and terrain read off of the board.
+template <typename Roller>
+FightLog
+ResolveFight(const Tilemap &map, const Unit &one, const Unit &two, Roller roll)
+{
+    const Tile &from = map.tiles[one.pos.col][one.pos.row];
+    const Tile &to = map.tiles[two.pos.col][two.pos.row];
+    int distance = ManhattanDistance(one.pos, two.pos);
+    return ResolveFight(one, two,
+                        PredictCombat(one, two, distance,
+                                      from.avoid, to.avoid,
+                                      from.defense, to.defense),
+                        distance, roll);
+}
+
+// Lands the whole fight on the units. Experience is left to the caller.
+void
+ApplyFight(const FightLog &log, Unit *one, Unit *two)
+{
+    one->SetHealth(log.OneHealthAfter());
+    two->SetHealth(log.TwoHealthAfter());
+    if(log.one_dies)
+        one->should_die = true;
+    if(log.two_dies)
+        two->should_die = true;
+}
+
+// ============================ Outcome Distributions ==========================
+// Every way a fight can go, and how likely each is. Walks the swings in the
+// same order as RollStrikes. Each one misses, hits or crits, and the fight
+// stops as soon as someone falls, so there are at most 3^4 ways it can go.
+// Those are folded together by how much health each side is left with.
+#define MAX_FIGHT_RESULTS 81
+
+struct FightResult
+{
+    int one_health;
+    int two_health;
+    double chance;
+};
+
+struct FightDistribution
+{
+    FightResult results[MAX_FIGHT_RESULTS];
+    int count = 0;
+
+    double one_dies = 0.0;
+    double two_dies = 0.0;
+    double one_health = 0.0; // Expected health left after the fight.
+    double two_health = 0.0;
+
+    void
+    Add(int one, int two, double chance)
+    {
+        one_health += one * chance;
+        two_health += two * chance;
+        if(one <= 0)
+            one_dies += chance;
+        if(two <= 0)
+            two_dies += chance;
+
+        for(int i = 0; i < count; ++i)
+        {
+            if(results[i].one_health == one && results[i].two_health == two)
+            {
+                results[i].chance += chance;
+                return;
+            }
+        }
+        SDL_assert(count < MAX_FIGHT_RESULTS);
+        results[count++] = {one, two, chance};
+    }
+};
+
+// Carries on from the given swing, with both healths as they stand.
+void
+EnumerateStrikes(const Outcome &outcome, int strike, int one_health, int two_health,
+                 double chance, FightDistribution *distribution)
+{
+    const bool order[MAX_STRIKES] = {true, false, true, false};
+    const bool allowed[MAX_STRIKES] = {true,
+                                       outcome.two_attacks,
+                                       outcome.one_doubles,
+                                       outcome.two_attacks && outcome.two_doubles};
+
+    while(strike < MAX_STRIKES && !allowed[strike])
+        ++strike;
+    if(strike == MAX_STRIKES || one_health <= 0 || two_health <= 0)
+    {
+        distribution->Add(max(one_health, 0), max(two_health, 0), chance);
+        return;
+    }
+
+    bool by_one = order[strike];
+    // A swing lands when d100 comes up under the hit chance.
+    double hit = clamp(by_one ? outcome.one_hit : outcome.two_hit, 0, 100) / 100.0;
+    double crit = clamp(by_one ? outcome.one_crit : outcome.two_crit, 0, 100) / 100.0;
+    int damage = by_one ? outcome.one_damage : outcome.two_damage;
+
+    if(hit < 1.0)
+        EnumerateStrikes(outcome, strike + 1, one_health, two_health,
+                         chance * (1.0 - hit), distribution);
+    if(hit > 0.0 && crit < 1.0)
+        EnumerateStrikes(outcome, strike + 1,
+                         by_one ? one_health : one_health - damage,
+                         by_one ? two_health - damage : two_health,
+                         chance * hit * (1.0 - crit), distribution);
+    if(hit > 0.0 && crit > 0.0)
+        EnumerateStrikes(outcome, strike + 1,
+                         by_one ? one_health : one_health - damage * CRIT_MULTIPLIER,
+                         by_one ? two_health - damage * CRIT_MULTIPLIER : two_health,
+                         chance * hit * crit, distribution);
+}
+
+// Everything that goes into a distribution. Used to look it back up.
+struct DistributionKey
+{
+    int values[12];
+
+    bool
+    operator==(const DistributionKey &other) const
+    {
+        for(int i = 0; i < 12; ++i)
+            if(values[i] != other.values[i])
+                return false;
+        return true;
+    }
+};
+
+struct DistributionKeyHash
+{
+    size_t
+    operator()(const DistributionKey &key) const
+    {
+        uint64_t result = 0;
+        for(int i = 0; i < 12; ++i)
+            result = Mix64(result ^ (uint32_t)key.values[i]);
+        return (size_t)result;
+    }
+};
+
+// NOTE: One per thread, like the AI caches. Emptied when it fills up.
+static thread_local unordered_map<DistributionKey, FightDistribution, DistributionKeyHash> GlobalDistributionCache;
+
+// The odds of every way a fight could end. Only worked out once per matchup,
+// so it is cheap enough for the preview every frame and the AI every swing.
+// NOTE: The reference only holds until the next call.
+const FightDistribution &
+DistributeFight(const Outcome &outcome, int one_health, int two_health)
+{
+    DistributionKey key = {{
+        outcome.one_attacks, outcome.one_doubles, outcome.one_damage,
+        outcome.one_hit, outcome.one_crit,
+        outcome.two_attacks, outcome.two_doubles, outcome.two_damage,
+        outcome.two_hit, outcome.two_crit,
+        one_health, two_health
+    }};
+
+    auto found = GlobalDistributionCache.find(key);
+    if(found != GlobalDistributionCache.end())
+        return found->second;
+
+    if(GlobalDistributionCache.size() >= FIGHT_CACHE_ENTRIES)
+        GlobalDistributionCache.clear();
+
+    FightDistribution &distribution = GlobalDistributionCache[key];
+    EnumerateStrikes(outcome, 0, one_health, two_health, 1.0, &distribution);
+    return distribution;
+}
+
 enum AttackType
 {
     MELEE,
@@ -114,6 +482,7 @@ enum AttackType
     //DIVINE,
 };
 
+// One swing of a fight being played back, for the animations.
 struct Attack
 {
     Unit *source;
@@ -156,19 +525,6 @@ struct Attack
         return animation;
     }
 
-    // Actually Applies damage
-    void
-    Resolve()
-    {
-        if(hit && !crit)
-        {
-            target->Damage(damage);
-        }
-        else if(hit && crit)
-        {
-            target->Damage(damage * CRIT_MULTIPLIER);
-        }
-    }
 };
 std::ostream
 &operator<<(std::ostream &os, const Attack &a)
@@ -191,7 +547,8 @@ struct Fight
     int distance = 0;
     direction one_to_two_direction = {0, 0};
 
-    queue<Attack> attack_queue = {};
+    FightLog log = {};
+    int played = 0; // Swings already landed.
 
     bool ready = false;
 
@@ -213,19 +570,34 @@ struct Fight
       distance(distance_in)
     {
         one_to_two_direction = direction_in;
-        Populate(PredictCombat(*one_in, *two_in,
-                               distance_in,
-                               one_avo_in,
-                               two_avo_in,
-                               one_def_in,
-                               two_def_in));
+        log = ResolveFight(*one_in, *two_in,
+                           PredictCombat(*one_in, *two_in,
+                                         distance_in,
+                                         one_avo_in,
+                                         two_avo_in,
+                                         one_def_in,
+                                         two_def_in),
+                           distance_in,
+                           [](RngStream stream) { return d100(stream); });
+
+        quadrant quad = Quadrant(one->pos);
+        lower_half_screen = (quad == BOTTOM_LEFT || quad == BOTTOM_RIGHT);
         ready = true;
     }
 
+    // The swing being played.
     Attack
     Current() const
     {
-        return attack_queue.front();
+        const FightEvent &event = log.events[played];
+        Attack attack = {};
+        attack.source = event.by_one ? one : two;
+        attack.target = event.by_one ? two : one;
+        attack.damage = event.damage;
+        attack.hit = event.hit;
+        attack.crit = event.crit;
+        attack.type = (distance > 1) ? RANGED : MELEE;
+        return attack;
     }
 
     void
@@ -246,8 +618,8 @@ struct Fight
 
             if(animation->Update())
             {
-                Current().Resolve();
-                attack_queue.pop();
+                Land(log.events[played]);
+                ++played;
                 ready = true;
                 delete animation;
                 animation = nullptr;
@@ -255,32 +627,18 @@ struct Fight
         }
         if(ready)
         {
-            if(!attack_queue.empty())
+            if(played < log.count)
             {
                 animation = Current().Execute();
-                //cout << attack_queue.front() << "\n";
+                //cout << Current() << "\n";
             }
             else
             {
-                if(one->health <= 0)
-                    one->should_die = true;
-                if(two->health <= 0)
-                    two->should_die = true;
-
-                Unit *experience_recipient = nullptr;
-                int experience_amount = 0;
+                MarkDead();
+                int experience_amount = Experience();
 
                 if(GlobalPlayerTurn)
                 {
-                    experience_recipient = one;
-
-                    experience_amount = EXP_FOR_COMBAT;
-                    if(two->should_die)
-                        experience_amount += two->xp_value;
-
-                    if(one->level > two->level)
-                        experience_amount /= 2;
-
                     if(one->should_die)
                     {
                         // TODO: Put DEATH CONVERSATION HERE!!!
@@ -295,17 +653,6 @@ struct Fight
                 }
                 else
                 {
-                    experience_recipient = two;
-
-                    experience_amount = 1;
-                    if(one->should_die)
-                        experience_amount += one->xp_value;
-
-                    if(two->level > one->level + 3) // Arbitrary threshold
-                        experience_amount /= 4;
-                    else if(two->level > one->level)
-                        experience_amount /= 2;
-
                     if(two->should_die)
                     {
                         // TODO: Put DEATH CONVERSATION HERE!!!
@@ -323,98 +670,78 @@ struct Fight
         }
     }
 
+    // Puts a swing's result on the units.
     void
-    Populate(const Outcome &outcome)
+    Land(const FightEvent &event)
     {
-        lower_half_screen = false;
-        quadrant quad = Quadrant(one->pos);
-        if(quad == BOTTOM_LEFT
-           || quad == BOTTOM_RIGHT)
-            lower_half_screen = true;
-            int one_dmg = CalculateDamage(*one, *two, two_defense_bonus);
-        int two_dmg = CalculateDamage(*two, *one, one_defense_bonus);
-        int one_accum = 0;
-        int two_accum = 0;
-        Attack attack = {one, two, one_dmg};
-        if(distance > 1)
-        {
-            attack.type = RANGED;
-        }
-        if(d100() < HitChance(*one, *two, two_avoid_bonus))
-        {
-            attack.hit = true;
-            if(d100() < CritChance(*one, *two))
-                attack.crit = true;
-        }
-        attack_queue.push(attack);
+        one->SetHealth(event.one_health);
+        two->SetHealth(event.two_health);
+    }
 
-        if(attack.hit)
-            two_accum += (attack.crit ? attack.damage * CRIT_MULTIPLIER : attack.damage);
+    // Flags whoever ran out of health.
+    void
+    MarkDead()
+    {
+        if(log.one_dies)
+            one->should_die = true;
+        if(log.two_dies)
+            two->should_die = true;
+    }
 
-        if(attack.hit && two->health - two_accum <= 0)
-            return;
+    // How much experience the player's unit earns from this fight.
+    // On the player's turn that's one, the attacker. Otherwise two, the defender.
+    int
+    Experience() const
+    {
+        return log.experience;
+    }
 
-        if(distance >= two->MinRange() && distance <= two->MaxRange())
-        {
-            attack = {two, one, two_dmg};
-            if(distance > 1)
-            {
-                attack.type = RANGED;
-            }
-            if(d100() < HitChance(*two, *one, one_avoid_bonus))
-            {
-                attack.hit = true;
-                if(d100() < CritChance(*two, *one))
-                    attack.crit = true;
-            }
-            attack_queue.push(attack);
+    // Skips the show. Lands every attack at once, without animations or
+    // state changes. The caller hands out experience.
+    void
+    ResolveInstantly()
+    {
+        ApplyFight(log, one, two);
+        played = log.count;
+        delete animation;
+        animation = nullptr;
+        ready = false;
+    }
+};
 
-            if(attack.hit)
-                one_accum += (attack.crit ? attack.damage * CRIT_MULTIPLIER : attack.damage);
+// ============================== Combat Log ===================================
+// A short written summary of a phase that was resolved without animations.
+struct CombatLog
+{
+    vector<string> lines = {};
+    int frames_left = 0;
 
-            if(attack.hit && one->health - one_accum <= 0)
-                return;
-        }
+    void
+    Clear()
+    {
+        lines.clear();
+        frames_left = 0;
+    }
 
-        attack = {one, two, one_dmg};
-        if(distance > 1)
-        {
-            attack.type = RANGED;
-        }
-        if(outcome.one_doubles)
-        {
-            if(d100() < HitChance(*one, *two, two_avoid_bonus))
-            {
-                attack.hit = true;
-                if(d100() < CritChance(*one, *two))
-                    attack.crit = true;
-            }
-            attack_queue.push(attack);
-            if(attack.hit)
-                two_accum += (attack.crit ? attack.damage * CRIT_MULTIPLIER : attack.damage);
+    void
+    Add(const string &line)
+    {
+        lines.push_back(line);
+    }
 
-            if(attack.hit && two->health - two_accum <= 0)
-                return;
-        }
+    // Puts the log up on screen for a little while.
+    void
+    Show()
+    {
+        frames_left = COMBAT_LOG_FRAMES;
+    }
 
-        if(distance >= two->MinRange() && distance <= two->MaxRange())
-        {
-            attack = {two, one, two_dmg};
-            if(distance > 1)
-            {
-                attack.type = RANGED;
-            }
-            if(outcome.two_doubles)
-            {
-                if(d100() < HitChance(*two, *one, one_avoid_bonus))
-                {
-                    attack.hit = true;
-                    if(d100() < CritChance(*two, *one))
-                        attack.crit = true;
-                }
-                attack_queue.push(attack);
-            } 
-        }
+    // called each frame
+    void
+    Update()
+    {
+        if(frames_left > 0)
+            --frames_left;
     }
 };
 
@@ -6,6 +6,7 @@
 #define GRID_H
 
 #include <queue>
+#include <functional>
 
 // ========================= grid helper functions ========================
 // returns true if the position is in-bounds.
@@ -61,6 +62,7 @@ InteractibleFrom(const Tilemap &map, const position &origin, int min, int max)
     { 
         position current = unexplored.front();
         unexplored.pop();
+        GlobalAIProfiler.CountNode();
 
         interactible.push_back(current);
 
@@ -99,6 +101,7 @@ AccessibleAndAttackableFrom(const Tilemap &map, position origin,
                             int mov, int min, int max, 
                             bool sourceIsAlly)
 {
+    ProfileScope profile(PROFILE_MOVEMENT);
     vector<position> accessible;
     vector<position> attackable;
 
@@ -125,6 +128,7 @@ AccessibleAndAttackableFrom(const Tilemap &map, position origin,
     { 
         position current = unexplored.front();
         unexplored.pop();
+        GlobalAIProfiler.CountNode();
 
         accessible.push_back(current);
 
@@ -253,10 +257,12 @@ PrintField(const vector<vector<position>> &field)
 
 // Get a field of directions which indicate shortest paths to a specified node.
 // Also produces a Distance Field, which indicates distance at each point.
-// NOTE: Currently just prints out the distance field.
+// Hand it distances_out to keep the distance field. 100 means unreachable.
 vector<vector<direction>>
-GetField(const Tilemap &map, position origin, bool is_ally)
+GetField(const Tilemap &map, position origin, bool is_ally,
+         vector<vector<int>> *distances_out = nullptr)
 {
+    ProfileScope profile(PROFILE_PATHS);
     vector<vector<direction>> field;
 	for(int col = 0; col < map.width; ++col)
 	{
@@ -295,6 +301,7 @@ GetField(const Tilemap &map, position origin, bool is_ally)
     {
         position current = unexplored.front();
         unexplored.pop();
+        GlobalAIProfiler.CountNode();
 
         for(int i = 0; i < 4; ++i)
         {
@@ -328,6 +335,8 @@ GetField(const Tilemap &map, position origin, bool is_ally)
     PrintField(field);
 #endif
 
+    if(distances_out)
+        *distances_out = distances;
     return field;
 }
 
@@ -367,28 +376,6 @@ GetPath(const Tilemap &map,
 }
 
 
-// Returns the furthest point down a path that a unit could move in a round.
-// A necessary workaround due to the fact that units can move through allies
-// but cannot land on their squares.
-position
-FurthestMovementOnPath(const Tilemap &map, const path &path_in, int movement)
-{
-    SDL_assert(path_in.size());
-    if(movement > path_in.size())
-    {
-        return {0, 0};
-    }
-    for(int i = movement; i > 0; --i) // Start at the furthest square, test all.
-    {
-        if(!map.tiles[path_in[i].col][path_in[i].row].occupant)
-        {
-            return path_in[i];
-        }
-    }
-    return {0, 0};
-}
-
-
 //  ================================ NEW AI METHODS ============================
 void
 PrintPossibilities(const vector<pair<position, Unit *>> &v)
@@ -401,13 +388,14 @@ PrintPossibilities(const vector<pair<position, Unit *>> &v)
     }
 }
 
-// Finds all possible squares for attacking enemies.
+// Finds all possible squares for attacking the unit's opponents.
 // SLOW: This shouldn't have to do exhaustive search. How about going through
 // the enemy units instead?
 vector<pair<position, Unit *>>
 FindAttackingSquares(const Tilemap &map, const Unit &unit,
                      const vector<position> &range)
 {
+    ProfileScope profile(PROFILE_ATTACKING_SQUARES);
     vector<pair<position, Unit *>> result = {};
     vector<position> interactible;
 
@@ -416,7 +404,8 @@ FindAttackingSquares(const Tilemap &map, const Unit &unit,
         interactible = InteractibleFrom(map, pos, unit.MinRange(), unit.MaxRange());
         for(const position &i : interactible)
         {
-            if(map.tiles[i.col][i.row].occupant && map.tiles[i.col][i.row].occupant->is_ally)
+            if(map.tiles[i.col][i.row].occupant &&
+               map.tiles[i.col][i.row].occupant->is_ally != unit.is_ally)
             {
                 result.push_back(pair<position, Unit *>(pos, map.tiles[i.col][i.row].occupant));
             }
@@ -428,8 +417,9 @@ FindAttackingSquares(const Tilemap &map, const Unit &unit,
 
 // Finds the nearest unit to the cursor, based on the given predicate expression.
 Unit *FindNearest(const Tilemap &map, const position &origin, 
-                  bool predicate(const Unit &), bool is_ally)
+                  function<bool(const Unit &)> predicate, bool is_ally)
 {
+    ProfileScope profile(PROFILE_NEAREST);
     int minDistance = 100;
     int distance = 0;
     Unit *result = nullptr;
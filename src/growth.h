@@ -0,0 +1,258 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Growth
+
+#ifndef GROWTH_H
+#define GROWTH_H
+
+#include <atomic>
+
+// ============================ Growth Projection ==============================
+// Where a unit's stats could be by a given level, and how likely each value is.
+//
+// Each level up rolls every stat on its own, the same way every time, so the
+// number of points a stat gains is a fixed part plus a binomial. That's worked
+// out exactly by ProjectGrowths(). SampleGrowths() plays the level ups out for
+// real, through Unit::LevelUp(), to check it, or for when the rules get too
+// tangled to work out by hand.
+
+#define GROWTH_STATS 8
+#define GROWTH_SAMPLES 50000 // Runs of level ups the editor samples.
+#define GROWTH_SAMPLES_PER_JOB 4096
+
+// One stat, and the growth that drives it.
+struct GrowthStat
+{
+    const char *name;
+    int Unit::*stat;
+    int Growths::*growth;
+};
+
+// In the order LevelUp() rolls them.
+static const GrowthStat GrowthStats[GROWTH_STATS] = {
+    {"hp",  &Unit::max_health, &Growths::health},
+    {"str", &Unit::strength,   &Growths::strength},
+    {"mag", &Unit::magic,      &Growths::magic},
+    {"spd", &Unit::speed,      &Growths::speed},
+    {"skl", &Unit::skill,      &Growths::skill},
+    {"lck", &Unit::luck,       &Growths::luck},
+    {"def", &Unit::defense,    &Growths::defense},
+    {"res", &Unit::resistance, &Growths::resistance},
+};
+
+// The chance of every value one stat could end up at.
+struct StatProjection
+{
+    int lowest = 0;           // The value odds[0] is the chance of.
+    vector<double> odds = {};
+
+    int
+    Highest() const
+    {
+        return lowest + (int)odds.size() - 1;
+    }
+
+    double
+    Mean() const
+    {
+        double mean = 0.0;
+        for(int i = 0; i < odds.size(); ++i)
+            mean += (lowest + i) * odds[i];
+        return mean;
+    }
+
+    // The lowest value the stat stays at or under with the given chance.
+    int
+    Percentile(double share) const
+    {
+        double total = 0.0;
+        for(int i = 0; i < odds.size(); ++i)
+        {
+            total += odds[i];
+            if(total >= share - EPSILON)
+                return lowest + i;
+        }
+        return Highest();
+    }
+
+    double
+    AtLeast(int value) const
+    {
+        double total = 0.0;
+        for(int i = max(value - lowest, 0); i < odds.size(); ++i)
+            total += odds[i];
+        return total;
+    }
+};
+
+struct GrowthProjection
+{
+    int level = 0;   // The level projected to.
+    int samples = 0; // Zero when worked out exactly.
+    StatProjection stats[GROWTH_STATS];
+};
+
+// What StatBoost() gives for a growth: points that always come, and the
+// percent chance of one more.
+pair<int, int>
+SplitGrowth(int growth)
+{
+    int fixed = 0;
+    while(growth > 100)
+    {
+        fixed += 1;
+        growth -= 100;
+    }
+    return {fixed, clamp(growth, 0, 100)};
+}
+
+// How many times the unit levels up on the way to the given level.
+int
+LevelsBetween(const Unit &unit, int target_level)
+{
+    return max(min(target_level, MAX_LEVEL) - unit.level, 0);
+}
+
+GrowthProjection
+ProjectGrowths(const Unit &unit, int target_level)
+{
+    GrowthProjection projection = {};
+    projection.level = max(min(target_level, MAX_LEVEL), unit.level);
+    int levels = LevelsBetween(unit, target_level);
+
+    for(int s = 0; s < GROWTH_STATS; ++s)
+    {
+        pair<int, int> split = SplitGrowth(unit.growths.*GrowthStats[s].growth);
+        double chance = split.second / 100.0;
+
+        // odds[k] is the chance of k extra points, one level at a time.
+        vector<double> odds = {1.0};
+        for(int level = 0; level < levels; ++level)
+        {
+            vector<double> next(odds.size() + 1, 0.0);
+            for(int k = 0; k < odds.size(); ++k)
+            {
+                next[k] += odds[k] * (1.0 - chance);
+                next[k + 1] += odds[k] * chance;
+            }
+            odds = next;
+        }
+
+        StatProjection &stat = projection.stats[s];
+        stat.lowest = unit.*GrowthStats[s].stat + levels * split.first;
+        stat.odds = odds;
+    }
+    return projection;
+}
+
+// One SampleGrowths() run, going on in the background. The jobs hold on to
+// it, so whoever asked can let go before it's done.
+struct GrowthSampling
+{
+    unique_ptr<Unit> unit = nullptr; // A copy, so the original can change.
+    uint64_t key = 0;                // Whatever the caller wants to match it by.
+    int level = 0;
+    int samples = 0;
+    int levels = 0;
+    int lowest[GROWTH_STATS] = {};
+    int width[GROWTH_STATS] = {};
+    vector<vector<int>> counts = {}; // Chunk by stat, then value.
+    atomic<int> remaining = {0};     // Chunks still running.
+    WaitGroup running;
+
+    bool
+    Done() const
+    {
+        return remaining.load() == 0;
+    }
+
+    // Adds the chunks up. Only once it's Done().
+    GrowthProjection
+    Collect() const
+    {
+        GrowthProjection projection = {};
+        projection.level = level;
+        projection.samples = samples;
+        int chunks = (int)counts.size() / GROWTH_STATS;
+        for(int s = 0; s < GROWTH_STATS; ++s)
+        {
+            StatProjection &stat = projection.stats[s];
+            stat.lowest = lowest[s];
+            stat.odds.assign(width[s], 0.0);
+            for(int c = 0; c < chunks; ++c)
+                for(int i = 0; i < width[s]; ++i)
+                    stat.odds[i] += (double)counts[c * GROWTH_STATS + s][i] / samples;
+        }
+        return projection;
+    }
+};
+
+// Starts levelling copies of the unit up, over and over, across the job pool.
+// The same seed always gives the same result.
+shared_ptr<GrowthSampling>
+StartSampleGrowths(const Unit &unit, int target_level, int samples, uint64_t seed)
+{
+    shared_ptr<GrowthSampling> sampling = make_shared<GrowthSampling>();
+    sampling->unit = make_unique<Unit>(unit);
+    sampling->key = seed;
+    sampling->level = max(min(target_level, MAX_LEVEL), unit.level);
+    sampling->samples = samples;
+    sampling->levels = LevelsBetween(unit, target_level);
+
+    // Every value each stat could reach, from the exact bounds.
+    for(int s = 0; s < GROWTH_STATS; ++s)
+    {
+        pair<int, int> split = SplitGrowth(unit.growths.*GrowthStats[s].growth);
+        sampling->lowest[s] = unit.*GrowthStats[s].stat + sampling->levels * split.first;
+        sampling->width[s] = sampling->levels + 1;
+    }
+
+    int chunks = (samples + GROWTH_SAMPLES_PER_JOB - 1) / GROWTH_SAMPLES_PER_JOB;
+    sampling->counts.resize(chunks * GROWTH_STATS);
+    sampling->remaining.store(chunks);
+    sampling->running.Add(chunks);
+    for(int c = 0; c < chunks; ++c)
+    {
+        GlobalJobs.Submit([sampling, seed, c]()
+            {
+                GrowthSampling &run = *sampling;
+                const Unit &original = *run.unit;
+
+                // Runs here if the pool isn't up, so leave the rolls as found.
+                RngStreams saved = GlobalRng;
+                GlobalRng.Seed(Mix64(seed + c));
+
+                Unit copy(original);
+                for(int s = 0; s < GROWTH_STATS; ++s)
+                    run.counts[c * GROWTH_STATS + s].assign(run.width[s], 0);
+
+                int count = min(GROWTH_SAMPLES_PER_JOB, run.samples - c * GROWTH_SAMPLES_PER_JOB);
+                for(int i = 0; i < count; ++i)
+                {
+                    copy.level = original.level;
+                    for(int s = 0; s < GROWTH_STATS; ++s)
+                        copy.*GrowthStats[s].stat = original.*GrowthStats[s].stat;
+                    for(int level = 0; level < run.levels; ++level)
+                        copy.LevelUp();
+                    for(int s = 0; s < GROWTH_STATS; ++s)
+                        ++run.counts[c * GROWTH_STATS + s][copy.*GrowthStats[s].stat - run.lowest[s]];
+                }
+
+                GlobalRng = saved;
+                run.remaining.fetch_sub(1);
+                run.running.Done();
+            });
+    }
+    return sampling;
+}
+
+// The same, waited on.
+GrowthProjection
+SampleGrowths(const Unit &unit, int target_level, int samples, uint64_t seed)
+{
+    shared_ptr<GrowthSampling> sampling = StartSampleGrowths(unit, target_level, samples, seed);
+    sampling->running.Wait();
+    return sampling->Collect();
+}
+
+#endif
@@ -0,0 +1,245 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Influence
+
+#ifndef INFLUENCE_H
+#define INFLUENCE_H
+
+#include <unordered_map>
+
+// =============================== Influence Maps ==============================
+// What each side could do to every tile by next turn, kept as layers:
+//  threat  | attack the side could bring down on the tile.
+//  support | how many of the side's healers and buffers could reach it.
+//  terrain | what standing on the tile is worth. The same for both sides.
+// Behaviors weigh a candidate square with a few lookups, instead of walking
+// every opponent's range all over again.
+//
+// Each unit's footprint is remembered, so Refresh() only redraws the units
+// that changed, and the ones close enough to a change to have been blocked
+// or let through by it.
+
+// The tiles one unit reaches, and what it adds to them.
+struct Footprint
+{
+    uint64_t key = 0; // The unit's zobrist when this was drawn.
+    position pos = {0, 0};
+    bool is_ally = false;
+    int reach = 0;    // Movement plus range. Changes further off can't matter.
+    int threat = 0;
+    vector<position> threatened = {};
+    vector<position> supported = {};
+};
+
+struct InfluenceMap
+{
+    int width = 0;
+    int height = 0;
+    uint64_t terrain_key = 0;
+    uint64_t board_key = 0;
+
+    // Indexed by is_ally, then col * height + row.
+    vector<int> threat[2];
+    vector<int> support[2];
+    vector<int> terrain = {};
+
+    unordered_map<const Unit *, Footprint> footprints = {};
+    int redrawn = 0; // Footprints redrawn by the last Refresh().
+
+    void
+    Reset()
+    {
+        width = 0;
+        height = 0;
+        terrain_key = 0;
+        board_key = 0;
+        footprints.clear();
+        redrawn = 0;
+    }
+
+    // Brings every layer in line with the board. Cheap when little has moved.
+    void
+    Refresh(const Tilemap &map)
+    {
+        if(map.width != width || map.height != height ||
+           map.terrain_key != terrain_key)
+            Rebuild(map);
+
+        uint64_t key = map.Hash();
+        if(key == board_key)
+            return;
+        ProfileScope profile(PROFILE_INFLUENCE);
+        board_key = key;
+        redrawn = 0;
+
+        // Who is on the board now.
+        unordered_map<const Unit *, bool> present = {};
+        for(int col = 0; col < width; ++col)
+            for(int row = 0; row < height; ++row)
+                if(map.tiles[col][row].occupant)
+                    present[map.tiles[col][row].occupant] = true;
+
+        // Tiles whose occupant came, went, or changed.
+        vector<position> changes = {};
+        vector<const Unit *> stale = {};
+        for(auto it = footprints.begin(); it != footprints.end();)
+        {
+            if(!present.count(it->first))
+            {
+                changes.push_back(it->second.pos);
+                Apply(it->second, -1);
+                it = footprints.erase(it);
+                continue;
+            }
+            if(it->second.key != it->first->zobrist)
+            {
+                changes.push_back(it->second.pos);
+                changes.push_back(it->first->pos);
+                stale.push_back(it->first);
+            }
+            ++it;
+        }
+        for(const pair<const Unit * const, bool> &entry : present)
+        {
+            if(!footprints.count(entry.first))
+            {
+                changes.push_back(entry.first->pos);
+                stale.push_back(entry.first);
+            }
+        }
+
+        // Anyone whose paths could run through one of those tiles.
+        for(const pair<const Unit * const, Footprint> &entry : footprints)
+        {
+            if(entry.second.key != entry.first->zobrist)
+                continue; // Already stale.
+            for(const position &change : changes)
+            {
+                if(ManhattanDistance(entry.second.pos, change) <= entry.second.reach + 1)
+                {
+                    stale.push_back(entry.first);
+                    break;
+                }
+            }
+        }
+
+        for(const Unit *unit : stale)
+        {
+            auto found = footprints.find(unit);
+            if(found != footprints.end())
+                Apply(found->second, -1);
+            Footprint &footprint = footprints[unit];
+            footprint = Draw(*unit, map);
+            Apply(footprint, 1);
+            ++redrawn;
+        }
+    }
+
+    // Attack the given side's opponents could bring down on the tile.
+    int
+    Threat(bool is_ally, const position &pos) const
+    {
+        return threat[!is_ally][pos.col * height + pos.row];
+    }
+
+    // Healers and buffers on the given side that could reach the tile.
+    int
+    Support(bool is_ally, const position &pos) const
+    {
+        return support[is_ally][pos.col * height + pos.row];
+    }
+
+    int
+    Terrain(const position &pos) const
+    {
+        return terrain[pos.col * height + pos.row];
+    }
+
+    // How good a tile is for the unit to end its move on. Higher is better.
+    int
+    Score(const Unit &unit, const position &pos) const
+    {
+        return Terrain(pos) +
+               INFLUENCE_SUPPORT_WEIGHT * Support(unit.is_ally, pos) -
+               INFLUENCE_THREAT_WEIGHT * Threat(unit.is_ally, pos);
+    }
+
+private:
+    void
+    Rebuild(const Tilemap &map)
+    {
+        Reset();
+        width = map.width;
+        height = map.height;
+        terrain_key = map.terrain_key;
+
+        for(int side = 0; side < 2; ++side)
+        {
+            threat[side].assign(width * height, 0);
+            support[side].assign(width * height, 0);
+        }
+        terrain.assign(width * height, 0);
+        for(int col = 0; col < width; ++col)
+            for(int row = 0; row < height; ++row)
+                terrain[col * height + row] = map.tiles[col][row].avoid +
+                    INFLUENCE_DEFENSE_VALUE * map.tiles[col][row].defense;
+    }
+
+    // Adds a footprint to the layers, or takes it back out with sign -1.
+    void
+    Apply(const Footprint &footprint, int sign)
+    {
+        for(const position &p : footprint.threatened)
+            threat[footprint.is_ally][p.col * height + p.row] += sign * footprint.threat;
+        for(const position &p : footprint.supported)
+            support[footprint.is_ally][p.col * height + p.row] += sign;
+    }
+
+    // Every tile the unit could strike, or lend a hand on, by next turn.
+    Footprint
+    Draw(const Unit &unit, const Tilemap &map) const
+    {
+        Footprint footprint = {};
+        footprint.key = unit.zobrist;
+        footprint.pos = unit.pos;
+        footprint.is_ally = unit.is_ally;
+        footprint.reach = unit.movement + max(unit.MaxRange(), 1);
+
+        if(unit.Armed())
+        {
+            footprint.threat = unit.Attack();
+            footprint.threatened = Reached(map, unit, unit.MinRange(), unit.MaxRange());
+        }
+        if(unit.ability == ABILITY_HEAL || unit.ability == ABILITY_BUFF)
+            footprint.supported = Reached(map, unit, 1, 1);
+        return footprint;
+    }
+
+    // The unit's movement and range, merged and without the doubles.
+    vector<position>
+    Reached(const Tilemap &map, const Unit &unit, int min, int max) const
+    {
+        pair<vector<position>, vector<position>> result =
+            CachedAccessibleAndAttackableFrom(map, unit.pos, unit.movement,
+                                              min, max, unit.is_ally);
+
+        vector<bool> seen(width * height, false);
+        vector<position> reached = {};
+        for(const vector<position> &tiles : {result.first, result.second})
+        {
+            for(const position &p : tiles)
+            {
+                if(seen[p.col * height + p.row])
+                    continue;
+                seen[p.col * height + p.row] = true;
+                reached.push_back(p);
+            }
+        }
+        return reached;
+    }
+};
+
+// NOTE: One per thread, like the caches, so headless tools can run many boards.
+static thread_local InfluenceMap GlobalInfluence;
+
+#endif
@@ -10,6 +10,11 @@
 bool
 Initialize()
 {
+#if HEADLESS
+    // No window, renderer, font or audio device. Textures, text and sounds
+    // come back as empty handles instead. See LoadTextureImage() and Sound.
+    return true;
+#endif
     // SDL
     if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) != 0)
         return false;
@@ -78,7 +83,10 @@ Initialize()
 // Frees up allocated memory.
 void Close()
 {
-    //SDL_DestroyTexture(ALL TEXTURES);
+#if HEADLESS
+    return;
+#endif
+    // Textures still held go down with the renderer. See TextureResource.
 
     //Close game controller
     //SDL_JoystickClose(gGameController);
@@ -93,6 +101,7 @@ void Close()
 
     TTF_CloseFont(GlobalFont);
     SDL_DestroyRenderer(GlobalRenderer);
+    GlobalRenderer = nullptr;
     SDL_DestroyWindow(GlobalWindow);
     TTF_Quit();
     IMG_Quit();
@@ -9,10 +9,7 @@
 void
 HandleEvents(InputState *input, SDL_Joystick *gamepad) 
 {
-    if(input->joystickCooldown)
-    {
-        --input->joystickCooldown;
-    }
+    // NOTE: joystickCooldown counts down in sim ticks, in main().
     SDL_Event Event;
     while(SDL_PollEvent(&Event))
     {
@@ -0,0 +1,132 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Jobs
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// ================================ Job Pool ===================================
+// A plain pool of worker threads pulling closures off of a queue.
+// NOTE: Jobs must never touch the live game state. Hand them a copy of
+// whatever they need, and collect the results on the main thread.
+struct ThreadPool
+{
+    vector<thread> workers = {};
+    queue<function<void()>> jobs = {};
+    mutex lock;
+    condition_variable wake;
+    bool stopping = false;
+
+    ~ThreadPool()
+    {
+        Stop();
+    }
+
+    // Spins up the workers. Zero means "one per core, minus the main thread".
+    void
+    Start(int count = 0)
+    {
+        if(!workers.empty())
+            return;
+
+        if(count <= 0)
+            count = (int)thread::hardware_concurrency() - 1;
+        if(count < 1)
+            count = 1;
+
+        stopping = false;
+        for(int i = 0; i < count; ++i)
+        {
+            workers.push_back(thread([this]()
+                {
+                    while(true)
+                    {
+                        function<void()> job;
+                        {
+                            unique_lock<mutex> guard(lock);
+                            wake.wait(guard, [this]() { return stopping || !jobs.empty(); });
+                            if(stopping && jobs.empty())
+                                return;
+                            job = std::move(jobs.front());
+                            jobs.pop();
+                        }
+                        job();
+                    }
+                }));
+        }
+    }
+
+    void
+    Stop()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(thread &worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    int
+    Size() const
+    {
+        return (int)workers.size();
+    }
+
+    // Runs the job on a worker, or right here if the pool was never started.
+    void
+    Submit(function<void()> job)
+    {
+        if(workers.empty())
+        {
+            job();
+            return;
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            jobs.push(std::move(job));
+        }
+        wake.notify_one();
+    }
+};
+
+// Counts outstanding jobs so that the submitter can block until they finish.
+struct WaitGroup
+{
+    int count = 0;
+    mutex lock;
+    condition_variable done;
+
+    void
+    Add(int amount = 1)
+    {
+        lock_guard<mutex> guard(lock);
+        count += amount;
+    }
+
+    void
+    Done()
+    {
+        lock_guard<mutex> guard(lock);
+        if(--count <= 0)
+            done.notify_all();
+    }
+
+    void
+    Wait()
+    {
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [this]() { return count <= 0; });
+    }
+};
+
+static ThreadPool GlobalJobs;
+
+#endif
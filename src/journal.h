@@ -0,0 +1,292 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Journal
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// ================================== Journal ==================================
+// Remembers how the board looked before each action, so actions can be taken
+// back one at a time.
+//
+// The first time an action touches a unit (any of Unit's mutators calls
+// JournalUnit()), the unit is written down as it was, with SnapshotUnit(). The
+// action ends once the game is back at rest, between a player's commands or
+// between enemy moves. Taking it back puts those units back as written, onto
+// the board if they'd died, along with whose turn it was and the rolls. Costs
+// what the action touched, not the size of the board.
+//
+// Each turn starts a new checkpoint, which writes down everyone. Only the last
+// JOURNAL_TURNS turns are kept.
+//
+// NOTE: The rolls come back too, so the same move plays out the same way.
+// Conversations and anything done in the editor's level tools aren't undone.
+
+struct JournalEntry
+{
+    vector<shared_ptr<Unit>> units = {}; // Touched, in the order they were.
+    vector<int> places = {};             // Where each was in Level::combatants.
+    vector<uint8_t> before = {};         // Each of them, from SnapshotUnit().
+
+    // As of when the entry was opened.
+    InterfaceState interface_state = NO_OP;
+    AIState ai_state = PLAYER_TURN;
+    bool player_turn = true;
+    bool turn_start = false;
+    RngStreams rng = {};
+
+    // The player did it, as opposed to the enemy phase or the start of a turn.
+    bool
+    PlayerAction() const
+    {
+        return player_turn && !turn_start;
+    }
+};
+
+struct Journal
+{
+    Level *level = nullptr;
+    uint64_t seed = 0;                 // The battle the entries belong to.
+    vector<JournalEntry> entries = {};
+    vector<int> turn_starts = {};      // The entry each turn starts at.
+    JournalEntry current = {};
+
+    // True between actions, when the last one can be closed off.
+    static bool
+    AtRest()
+    {
+        if(GlobalTurnStart)
+            return false;
+        if(GlobalPlayerTurn)
+            return GlobalInterfaceState == NEUTRAL_OVER_GROUND ||
+                   GlobalInterfaceState == NEUTRAL_OVER_ENEMY ||
+                   GlobalInterfaceState == NEUTRAL_OVER_UNIT ||
+                   GlobalInterfaceState == NEUTRAL_OVER_DEACTIVATED_UNIT;
+        return GlobalAIState == FINDING_NEXT;
+    }
+
+    void
+    Clear()
+    {
+        seed = level ? level->seed : 0;
+        entries.clear();
+        turn_starts.clear();
+        Open();
+    }
+
+    // Drops everything if the level's been swapped out since.
+    void
+    CheckBattle()
+    {
+        if(level && level->seed != seed)
+            Clear();
+    }
+
+    // Called by the unit, before it changes.
+    void
+    Touch(Unit *unit)
+    {
+        if(!level)
+            return;
+        CheckBattle();
+        for(const shared_ptr<Unit> &touched : current.units)
+            if(touched.get() == unit)
+                return;
+
+        // Units that aren't on the board (copies, the roster) aren't tracked.
+        for(int i = 0; i < level->combatants.size(); ++i)
+        {
+            if(level->combatants[i].get() == unit)
+            {
+                SnapshotWriter writer = {&current.before};
+                SnapshotUnit(writer, *unit);
+                current.units.push_back(level->combatants[i]);
+                current.places.push_back(i);
+                return;
+            }
+        }
+    }
+
+    // Closes off the action in progress, if it did anything.
+    void
+    Mark()
+    {
+        CheckBattle();
+        if(!current.units.empty())
+            entries.push_back(move(current));
+        Open();
+    }
+
+    // Checkpoints the start of a turn. Call before the turn's upkeep.
+    void
+    StartTurn()
+    {
+        Mark();
+        turn_starts.push_back((int)entries.size());
+        for(const shared_ptr<Unit> &unit : level->combatants)
+            Touch(unit.get());
+
+        if(turn_starts.size() > JOURNAL_TURNS)
+        {
+            int dropped = turn_starts[1];
+            entries.erase(entries.begin(), entries.begin() + dropped);
+            turn_starts.erase(turn_starts.begin());
+            for(int &start : turn_starts)
+                start -= dropped;
+        }
+    }
+
+    // Takes back the last action. Returns a unit it moved, or nullptr if there
+    // was nothing to take back.
+    Unit *
+    Rewind()
+    {
+        Mark();
+        if(entries.empty())
+            return nullptr;
+        Unit *result = Undo(entries.back());
+        Pop();
+        return result;
+    }
+
+    // Takes back everything since the player's last action, and that too.
+    Unit *
+    RewindPlayerAction()
+    {
+        Mark();
+        bool any = false;
+        for(const JournalEntry &entry : entries)
+            any = any || entry.PlayerAction();
+        if(!any)
+            return nullptr;
+
+        Unit *result = nullptr;
+        bool done = false;
+        while(!done)
+        {
+            done = entries.back().PlayerAction();
+            result = Undo(entries.back());
+            Pop();
+        }
+        return result;
+    }
+
+    // Back to just after this turn's upkeep. If that's where things are
+    // already, back to the turn before.
+    bool
+    RewindTurn()
+    {
+        Mark();
+        if(turn_starts.empty())
+            return false;
+        int keep = turn_starts.back() + 1;
+        if(entries.size() <= keep)
+        {
+            if(turn_starts.size() < 2)
+                return false;
+            keep = turn_starts[turn_starts.size() - 2] + 1;
+        }
+        while(entries.size() > keep)
+        {
+            Undo(entries.back());
+            Pop();
+        }
+        return true;
+    }
+
+private:
+    void
+    Open()
+    {
+        current = {};
+        current.interface_state = GlobalInterfaceState;
+        current.ai_state = GlobalAIState;
+        current.player_turn = GlobalPlayerTurn;
+        current.turn_start = GlobalTurnStart;
+        current.rng = GlobalRng;
+    }
+
+    void
+    Pop()
+    {
+        entries.pop_back();
+        while(!turn_starts.empty() && turn_starts.back() >= entries.size())
+            turn_starts.pop_back();
+        Open();
+    }
+
+    bool
+    OnBoard(const Unit *unit) const
+    {
+        for(const shared_ptr<Unit> &combatant : level->combatants)
+            if(combatant.get() == unit)
+                return true;
+        return false;
+    }
+
+    Unit *
+    Undo(const JournalEntry &entry)
+    {
+        Tilemap &map = level->map;
+
+        // Off the board first, in case one goes back where another stands.
+        for(const shared_ptr<Unit> &unit : entry.units)
+        {
+            Tile &tile = map.tiles[unit->pos.col][unit->pos.row];
+            if(tile.occupant == unit.get())
+                tile.occupant = nullptr;
+        }
+
+        SnapshotReader reader = {&entry.before};
+        for(const shared_ptr<Unit> &unit : entry.units)
+        {
+            SnapshotUnit(reader, *unit);
+            unit->animation_offset = {0, 0};
+            unit->last_offset = {0, 0};
+            unit->sheet.ChangeTrack(TRACK_IDLE);
+            unit->Rehash();
+            unit->Derive();
+        }
+        SDL_assert(reader.ok);
+
+        // The dead come back where they were in the list, so the enemy phase
+        // goes in the same order.
+        vector<int> order(entry.units.size());
+        for(int i = 0; i < order.size(); ++i)
+            order[i] = i;
+        sort(order.begin(), order.end(),
+             [&](int a, int b) { return entry.places[a] < entry.places[b]; });
+        for(int i : order)
+        {
+            if(!OnBoard(entry.units[i].get()))
+            {
+                int place = min(entry.places[i], (int)level->combatants.size());
+                level->combatants.insert(level->combatants.begin() + place, entry.units[i]);
+            }
+        }
+
+        for(const shared_ptr<Unit> &unit : entry.units)
+            map.tiles[unit->pos.col][unit->pos.row].occupant = unit.get();
+
+        GlobalInterfaceState = entry.interface_state;
+        GlobalAIState = entry.ai_state;
+        GlobalPlayerTurn = entry.player_turn;
+        GlobalTurnStart = entry.turn_start;
+        GlobalRng = entry.rng;
+
+        return entry.units.empty() ? nullptr : entry.units.front().get();
+    }
+};
+
+// NOTE: Only the main thread's. Headless tools and worker threads leave it
+// null, so their units go untracked.
+static thread_local Journal *GlobalJournal = nullptr;
+
+void
+JournalUnit(Unit *unit)
+{
+    if(GlobalJournal)
+        GlobalJournal->Touch(unit);
+}
+
+#endif
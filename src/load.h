@@ -45,68 +45,50 @@ LoadConversation(string path, string filename,
     conversation.filename = filename;
     conversation.pos = pos_in;
 
-    string line;
-    string type;
-    string rest;
-
     Expression one_expression = EXPR_NEUTRAL;
     Expression two_expression = EXPR_NEUTRAL;
     ConversationEvent conversation_event = CONV_NONE;
 
-    ifstream fp;
-    fp.open(path + filename);
-    if(!fp.is_open())
+    LineParser parser;
+    if(!parser.Open(path + filename))
         SDL_assert(!"ERROR LoadConversation: File could not be opened.\n");
 
-    while(getline(fp, line))
+    while(parser.NextLine())
     {
-        if(line.empty())
-            continue;
-
-        type = line.substr(0, 3);
-        rest = line.substr(4);
-
-        if(type == "MUS")
+        string_view rest = parser.Rest();
+        switch(parser.tag)
         {
-            conversation.song = GetMusic(rest);
-        }
-        else if(type == "SP1")
-        {
-            conversation.one = GetUnitByName(units, rest);
-        }
-        else if(type == "SP2")
-        {
-            conversation.two = GetUnitByName(units, rest);
-        }
-        else if(type == "EX1")
-        {
-            one_expression = GetExpressionFromString(rest);
-        }
-        else if(type == "EX2")
-        {
-            two_expression = GetExpressionFromString(rest);
-        }
-        else if(type == "EVE")
-        {
-            conversation_event = GetConversationEventFromString(rest);
-        }
-        else if(type == "ONE")
-        {
-            conversation.prose.push_back({SPEAKER_ONE, rest, one_expression, conversation_event});
-        }
-        else if(type == "TWO")
-        {
-            conversation.prose.push_back({SPEAKER_TWO, rest, two_expression, conversation_event});
-        }
-        else if(type == "COM")
-        {
-        }
-        else
-        {
-            cout << "WARN LoadConversation: Unrecognized line type in " << filename << ".\n";
+            case(Tag("MUS")):
+                conversation.song = GetMusic(string(rest));
+                break;
+            case(Tag("SP1")):
+                conversation.one = GetUnitByName(units, string(rest));
+                break;
+            case(Tag("SP2")):
+                conversation.two = GetUnitByName(units, string(rest));
+                break;
+            case(Tag("EX1")):
+                one_expression = GetExpressionFromString(string(rest));
+                break;
+            case(Tag("EX2")):
+                two_expression = GetExpressionFromString(string(rest));
+                break;
+            case(Tag("EVE")):
+                conversation_event = GetConversationEventFromString(string(rest));
+                break;
+            case(Tag("ONE")):
+                conversation.prose.push_back({SPEAKER_ONE, string(rest), one_expression, conversation_event});
+                break;
+            case(Tag("TWO")):
+                conversation.prose.push_back({SPEAKER_TWO, string(rest), two_expression, conversation_event});
+                break;
+            case(Tag("COM")):
+                break;
+            default:
+                parser.Warn("LoadConversation: Unrecognized line type");
+                break;
         }
     }
-    fp.close();
 
     SDL_assert(conversation.one && conversation.two);
 
@@ -119,6 +101,9 @@ LoadConversation(string path, string filename,
 Texture
 LoadTextureText(string text, SDL_Color color, int line_length)
 {
+#if HEADLESS
+    return Texture(nullptr, "", "", HEADLESS_TEXTURE_SIZE, HEADLESS_TEXTURE_SIZE);
+#endif
     SDL_Texture *texture = nullptr;
     SDL_Surface *surface = nullptr;
 
@@ -134,249 +119,364 @@ LoadTextureText(string text, SDL_Color color, int line_length)
     SDL_assert(texture);
     SDL_FreeSurface(surface);
 
-    return Texture(texture, "", "", width, height);
+    return Texture(GlobalTextureCache.Add(texture, "", TEXTURE_TEXT, width, height),
+                   "", "", width, height);
 }
 
-// Loads a texture displaying an image, given a path to it.
+// Loads a texture displaying an image, given a path to it. Shares it with
+// anything else that's already loaded the same image, and picks up any
+// decoding already done by GlobalTextureCache.Request().
 Texture
 LoadTextureImage(string path, string filename)
 {
-    SDL_Texture *texture = nullptr;
-    SDL_Surface *surface = nullptr;
+#if HEADLESS
+    return Texture(nullptr, path, filename, HEADLESS_TEXTURE_SIZE, HEADLESS_TEXTURE_SIZE);
+#endif
+    shared_ptr<TextureResource> resource = GlobalTextureCache.Load(path, filename);
+    return Texture(resource, path, filename, resource->width, resource->height);
+}
 
-    surface = IMG_Load((path + filename).c_str());
-    SDL_assert(surface);
-    int width = surface->w;
-    int height = surface->h;
-    texture = SDL_CreateTextureFromSurface(GlobalRenderer, surface);
-    SDL_assert(texture);
-    SDL_FreeSurface(surface);
+// A texture that's only named, for now. Portraits start out this way, and
+// are loaded when they're needed. See portrait.h.
+Texture
+TextureReference(string path, string filename)
+{
+    return Texture(nullptr, path, filename, 0, 0);
+}
 
-    return Texture(texture, path, filename, width, height);
+// A sprite sheet, off the atlas if it was packed, or on a texture of its own.
+Spritesheet
+LoadSpritesheet(const string &path, const string &filename, int size, int speed)
+{
+    auto found = GlobalSpriteAtlas.regions.find(path + filename);
+    if(found == GlobalSpriteAtlas.regions.end())
+        return Spritesheet(LoadTextureImage(path, filename), size, speed);
+
+    Texture texture = GlobalSpriteAtlas.pages[found->second.page];
+    texture.dir = path;
+    texture.filename = filename;
+    return Spritesheet(texture, found->second.rect, size, speed);
 }
 
 // =================================== level data ===============================
-// helper to split strings by a delimiter
-vector<string> split(const string &text, char sep) {
-    vector<string> tokens;
-    size_t start = 0, end = 0;
-    while ((end = text.find(sep, start)) != string::npos) {
-        if (end != start) {
-          tokens.push_back(text.substr(start, end - start));
+// Puts down one of the level's units. Whoever's in the party comes as they are,
+// and anyone else comes from the base units file.
+void
+SpawnUnit(Level *level, string_view name, int col, int row,
+          AIBehavior ai_behavior, bool is_boss,
+          const vector<shared_ptr<Unit>> &units,
+          const vector<shared_ptr<Unit>> &party)
+{
+    // NOTE: We go through party first. If we have any matches, we plop those down.
+    // Otherwise, we'll grab them from the base units file.
+    shared_ptr<Unit> unitCopy;
+    for(const shared_ptr<Unit> &unit : party)
+    {
+        if(hash<string_view>{}(name) == unit->ID())
+            unitCopy = make_shared<Unit>(*unit);
+    }
+
+    if(!unitCopy)
+    {
+        for(const shared_ptr<Unit> &unit : units)
+        {
+            if(hash<string_view>{}(name) == unit->ID())
+                unitCopy = make_shared<Unit>(*unit);
         }
-        start = end + 1;
     }
-    if (end != start) {
-       tokens.push_back(text.substr(start));
+
+    SDL_assert(unitCopy);
+    unitCopy->SetSpawn(level->spawned++);
+    unitCopy->SetPosition(position(col, row));
+    unitCopy->ai_behavior = ai_behavior;
+    unitCopy->is_boss = is_boss;
+    level->combatants.push_back(std::move(unitCopy));
+    level->map.tiles[col][row].occupant = level->combatants.back().get();
+}
+
+// CIRCULAR | See compile.h. False if there's no compiled copy to load.
+bool LoadCompiledLevel(const string &, const vector<shared_ptr<Unit>> &,
+                       const vector<shared_ptr<Unit>> &, Level *);
+
+// CIRCULAR | See portrait.h.
+void PrefetchPortraits(const ConversationList &);
+
+// The campaign's levels, in the order they're played.
+vector<string>
+CampaignLevels()
+{
+    return {"l0.txt", "l1.txt", "l2.txt", "l3.txt",
+            "l4.txt", "l5.txt", "l6.txt", "l7.txt"};
+}
+
+// Where a level comes in the campaign, going by its file. -1 if it isn't in it.
+int
+CampaignIndex(const string &filename)
+{
+    vector<string> levels = CampaignLevels();
+    for(int i = 0; i < levels.size(); ++i)
+    {
+        size_t at = filename.size() - levels[i].size();
+        if(filename.size() >= levels[i].size() &&
+           filename.compare(at, string::npos, levels[i]) == 0 &&
+           (at == 0 || filename[at - 1] == '/'))
+            return i;
     }
-    return tokens;
+    return -1;
 }
 
-// loads a level from a file.
-Level
-LoadLevel(string filename_in, const vector<shared_ptr<Unit>> &units,
-          const vector<shared_ptr<Unit>> &party)
+// Every battle is rolled from its own seed. Pass it to --seed, along with the
+// battle's --level, to replay it.
+void
+StartLevel(Level *level)
 {
-    string line;
-    string type;
-    string rest;
-    vector<string> tokens;
+    level->map.RehashTerrain();
+
+    level->seed = GlobalRng.StartBattle();
+#ifndef EMBLEM_TOOL
+    cout << "Battle seed: " << level->seed;
+    int index = CampaignIndex(level->name);
+    if(index >= 0)
+        cout << " (replay with --level " << index << " --seed " << level->seed << ")";
+    cout << "\n";
+#endif
+}
 
+// loads a level from its text file, ignoring any compiled copy.
+Level
+LoadLevelText(string filename_in, const vector<shared_ptr<Unit>> &units,
+              const vector<shared_ptr<Unit>> &party)
+{
     int mapRow = 0;
 
     Level level;
     level.name = filename_in;
 
-    ifstream fp;
-    fp.open(DATA_PATH + filename_in);
-    if(!fp.is_open())
+    LineParser parser;
+    if(!parser.Open(DATA_PATH + filename_in))
         SDL_assert(!"ERROR LoadLevel: File could not be opened!\n");
 
-    while(getline(fp, line))
+    while(parser.NextLine())
     {
-        if(line.empty())
-            continue;
-
-        type = line.substr(0, 3);
-        rest = line.substr(4);
-        tokens = split(rest, ' ');
-
-        if(type == "OBJ")
-        {
-            level.objective = (Objective)stoi(rest);
-        }
-        else if(type == "ATL")
-        {
-            level.map.atlas = LoadTextureImage(TILESETS_PATH, rest);
-        }
-        else if(type == "PRE")
-        {
-            level.conversations.prelude = 
-                    LoadConversation(PRELUDES_PATH, rest, units);
-        }
-        else if(type == "MID")
-        {
-            level.conversations.mid_battle.push_back(
-                    LoadConversation(CONVERSATIONS_PATH, rest, units));
-        }
-        else if(type == "CNV")
+        string_view rest = parser.Rest();
+        switch(parser.tag)
         {
-            level.conversations.list.push_back(
-                    LoadConversation(CONVERSATIONS_PATH, rest, units));
-        }
-        else if(type == "VIL")
-        {
-            int col = stoi(tokens[0]);
-            int row = stoi(tokens[1]);
-
-            level.conversations.villages.push_back(
-                    LoadConversation(VILLAGES_PATH, tokens[2], units, position(col, row)));
-        }
-        else if(type == "MUS")
-        {
-            level.song = GetMusic(rest);
-        }
-        else if(type == "WDT")
-        {
-            level.map.width = stoi(rest);
-        }
-        else if(type == "HGT")
-        {
-            level.map.height = stoi(rest);
-            level.map.tiles.resize(level.map.width, vector<Tile>(level.map.height));
-            for(int col = 0; col < level.map.width; ++col)
+            case(Tag("OBJ")):
+                level.objective = (Objective)parser.Int(' ');
+                break;
+            case(Tag("ATL")):
+                level.map.atlas = LoadTextureImage(TILESETS_PATH, string(rest));
+                break;
+            case(Tag("PRE")):
+                level.conversations.prelude =
+                        LoadConversation(PRELUDES_PATH, string(rest), units);
+                break;
+            case(Tag("MID")):
+                level.conversations.mid_battle.push_back(
+                        LoadConversation(CONVERSATIONS_PATH, string(rest), units));
+                break;
+            case(Tag("CNV")):
+                level.conversations.list.push_back(
+                        LoadConversation(CONVERSATIONS_PATH, string(rest), units));
+                break;
+            case(Tag("VIL")):
+            {
+                int col = parser.Int(' ');
+                int row = parser.Int(' ');
+                string_view name = parser.Field(' ');
+                if(parser.ok)
+                    level.conversations.villages.push_back(
+                            LoadConversation(VILLAGES_PATH, string(name), units, position(col, row)));
+            } break;
+            case(Tag("MUS")):
+                level.song = GetMusic(string(rest));
+                break;
+            case(Tag("WDT")):
+                level.map.width = parser.Int(' ');
+                break;
+            case(Tag("HGT")):
             {
-                for(int row = 0; row < level.map.height; ++row)
+                level.map.height = parser.Int(' ');
+                level.map.tiles.resize(level.map.width, vector<Tile>(level.map.height));
+                for(int col = 0; col < level.map.width; ++col)
                 {
-                    level.map.tiles[col][row] = {};
+                    for(int row = 0; row < level.map.height; ++row)
+                    {
+                        level.map.tiles[col][row] = {};
+                    }
                 }
-            }
-        }
-        else if(type == "MAP")
-        {
-            for(int col = 0; col < level.map.width; ++col)
-                level.map.tiles[col][mapRow] = TileTypeToTile((TileType)stoi(tokens[col]));
-
-            ++mapRow;
-        }
-        else if(type == "UNT")
-        {
-            // NOTE: We go through party first. If we have any matches, we plop those down.
-            // Otherwise, we'll grab them from the base units file.
-            shared_ptr<Unit> unitCopy;
-            for(const shared_ptr<Unit> &unit : party)
-            {
-                if(hash<string>{}(tokens[0]) == unit->ID())
-                    unitCopy = make_shared<Unit>(*unit);
-            }
-
-            if(!unitCopy)
+            } break;
+            case(Tag("MAP")):
             {
-                for(const shared_ptr<Unit> &unit : units)
+                if(mapRow >= level.map.height)
                 {
-                    if(hash<string>{}(tokens[0]) == unit->ID())
-                        unitCopy = make_shared<Unit>(*unit);
+                    parser.Error("More MAP rows than HGT");
+                    break;
                 }
-            }
-
-            SDL_assert(unitCopy);
-            int col = stoi(tokens[1]);
-            int row = stoi(tokens[2]);
-
-            unitCopy->pos.col = col;
-            unitCopy->pos.row = row;
-            unitCopy->ai_behavior = (AIBehavior)stoi(tokens[3]);
-            unitCopy->is_boss = (bool)stoi(tokens[4]);
-            level.combatants.push_back(std::move(unitCopy));
-            level.map.tiles[col][row].occupant = level.combatants.back().get();
-        }
-        else if(type == "COM")
-        {
+                for(int col = 0; col < level.map.width && parser.ok; ++col)
+                    level.map.tiles[col][mapRow] = TileTypeToTile((TileType)parser.Int(' '));
+
+                ++mapRow;
+            } break;
+            case(Tag("UNT")):
+            {
+                string_view name = parser.Field(' ');
+                int col = parser.Int(' ');
+                int row = parser.Int(' ');
+                AIBehavior ai_behavior = (AIBehavior)parser.Int(' ');
+                bool is_boss = (bool)parser.Int(' ');
+                if(parser.ok)
+                    SpawnUnit(&level, name, col, row, ai_behavior, is_boss, units, party);
+            } break;
+            case(Tag("COM")):
+                break;
+            default:
+                parser.Warn("LoadLevel: Unhandled line type");
+                break;
         }
-        else
+    }
+
+	return level;
+}
+
+// loads a level, from its compiled copy if there's a current one.
+Level
+LoadLevel(string filename_in, const vector<shared_ptr<Unit>> &units,
+          const vector<shared_ptr<Unit>> &party)
+{
+    Level level;
+    level.name = filename_in;
+    if(!LoadCompiledLevel(filename_in, units, party, &level))
+        level = LoadLevelText(filename_in, units, party);
+
+    PrefetchPortraits(level.conversations);
+    StartLevel(&level);
+    return level;
+}
+
+// The allies left standing at the end of a level, rested up for the next one.
+vector<shared_ptr<Unit>>
+CarryParty(const Level &level)
+{
+    vector<shared_ptr<Unit>> party = {};
+    for(const shared_ptr<Unit> &unit : level.combatants)
+    {
+        if(unit->is_ally)
         {
-            cout << "Warning LoadLevel: Unhandled line type: " << type << "\n";
+            unit->SetHealth(unit->max_health);
+            unit->ClearBuff();
+            unit->turns_active = -1;
+            unit->Activate();
+            party.push_back(unit);
         }
     }
-    fp.close();
+    return party;
+}
 
-	return level;
+// The sprite sheets named in a units file, to pack ahead of loading it.
+vector<string>
+UnitSprites(const string &filename_in)
+{
+    vector<string> result = {};
+
+    LineParser parser;
+    if(!parser.Open(filename_in))
+        return result;
+    while(parser.NextLine())
+    {
+        if(parser.tag != Tag("UNT"))
+            continue;
+        for(int field = 0; field < 25; ++field) // name ... secondary
+            parser.Field('\t');
+        string_view sprite = parser.Field('\t');
+        if(!sprite.empty() && find(result.begin(), result.end(), sprite) == result.end())
+            result.push_back(string(sprite));
+    }
+    return result;
 }
 
 // loads units from a file. returns a vector of them.
 vector<shared_ptr<Unit>>
 LoadUnits(string filename_in)
 {
-    string line;
-	string type;
-	string rest;
-	vector<string> tokens;
-
 	vector<shared_ptr<Unit>> units;
 
-    ifstream fp;
-    fp.open(filename_in);
-    SDL_assert(fp.is_open());
-    while(getline(fp, line))
+    LineParser parser;
+    bool opened = parser.Open(filename_in);
+    SDL_assert(opened);
+    while(parser.NextLine())
     {
-        if(!line.empty())
-        {
-            type = line.substr(0, 3);
-            rest = line.substr(4);
+        if(parser.tag != Tag("UNT"))
+            continue;
 
-            if(type == "UNT")
-            {
-                tokens = split(rest, '\t');
-                units.push_back(make_shared<Unit>(
-                    tokens[0],									// name
-                    tokens[1] == "Ally" ? true : false,			// team
-
-                    // Bases
-                    stoi(tokens[2]),							// movement
-                    stoi(tokens[3]),							// health
-                    stoi(tokens[3]),							// max health
-
-                    stoi(tokens[4]),							// strength
-                    stoi(tokens[5]),							// magic
-                    stoi(tokens[6]),							// speed
-                    stoi(tokens[7]),						    // skill
-                    stoi(tokens[8]),						    // luck
-                    stoi(tokens[9]),							// defense
-                    stoi(tokens[10]),							// resistance
-
-                    stoi(tokens[11]),						    // level
-
-                    (Ability)stoi(tokens[12]),				    // ability
-
-                    (AIBehavior)stoi(tokens[13]),               // ai behavior
-
-                    stoi(tokens[14]),                           // xp value
-
-                    // Growths
-                    stoi(tokens[15]),                           // health
-                    stoi(tokens[16]),                           // strength
-                    stoi(tokens[17]),                           // magic
-                    stoi(tokens[18]),                           // speed
-                    stoi(tokens[19]),                           // skill
-                    stoi(tokens[20]),                           // luck
-                    stoi(tokens[21]),                           // defense
-                    stoi(tokens[22]),                           // resistance
-
-                    // Items
-                    (ItemType)stoi(tokens[23]),                 // primary
-                    (ItemType)stoi(tokens[24]),                 // secondary
-
-                    // Textures
-                    Spritesheet(LoadTextureImage(SPRITES_PATH, tokens[25]), 32, ANIMATION_SPEED), // path to texture
-                    LoadTextureImage(FULLS_PATH, tokens[26]),   // neutral
-                    LoadTextureImage(FULLS_PATH, tokens[27]),   // happy
-                    LoadTextureImage(FULLS_PATH, tokens[28]),   // angry
-                    LoadTextureImage(FULLS_PATH, tokens[29])    // wince
-                ));
-            }
-        }
+        // NOTE: Read in the order they're in the file. Arguments to the
+        // constructor could be worked out in any order.
+        string_view name = parser.Field('\t');
+        string_view team = parser.Field('\t');
+        int stats[13] = {};             // movement ... xp value
+        for(int &stat : stats)
+            stat = parser.Int('\t');
+        int growths[8] = {};            // health ... resistance
+        for(int &growth : growths)
+            growth = parser.Int('\t');
+        int primary = parser.Int('\t');
+        int secondary = parser.Int('\t');
+        string_view textures[5] = {};   // sprite, neutral, happy, angry, wince
+        for(string_view &texture : textures)
+            texture = parser.Field('\t');
+
+        if(textures[4].empty())
+            parser.Error("Expected five textures", parser.column);
+        if(!parser.ok)
+            continue;
+
+        units.push_back(make_shared<Unit>(
+            string(name),								// name
+            team == "Ally" ? true : false,				// team
+
+            // Bases
+            stats[0],									// movement
+            stats[1],									// health
+            stats[1],									// max health
+
+            stats[2],									// strength
+            stats[3],									// magic
+            stats[4],									// speed
+            stats[5],								    // skill
+            stats[6],								    // luck
+            stats[7],									// defense
+            stats[8],									// resistance
+
+            stats[9],								    // level
+
+            (Ability)stats[10],						    // ability
+
+            (AIBehavior)stats[11],                      // ai behavior
+
+            stats[12],                                  // xp value
+
+            // Growths
+            growths[0],                                 // health
+            growths[1],                                 // strength
+            growths[2],                                 // magic
+            growths[3],                                 // speed
+            growths[4],                                 // skill
+            growths[5],                                 // luck
+            growths[6],                                 // defense
+            growths[7],                                 // resistance
+
+            // Items
+            (ItemType)primary,                          // primary
+            (ItemType)secondary,                        // secondary
+
+            // Textures
+            LoadSpritesheet(SPRITES_PATH, string(textures[0]), 32, ANIMATION_SPEED), // path to texture
+            TextureReference(FULLS_PATH, string(textures[1])), // neutral
+            TextureReference(FULLS_PATH, string(textures[2])), // happy
+            TextureReference(FULLS_PATH, string(textures[3])), // angry
+            TextureReference(FULLS_PATH, string(textures[4]))  // wince
+        ));
     }
-    fp.close();
 
 	return units;
 }
@@ -0,0 +1,167 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Parse
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <charconv>
+#include <fstream>
+#include <string_view>
+
+// ================================== Parsing ==================================
+// Reads the text files (units.tsv, the levels, the conversations) a line at a
+// time, out of one buffer holding the whole file. Fields come back as
+// string_views into that buffer and numbers are read in place, so going
+// through a file allocates nothing past the buffer itself.
+//
+// Every line starts with a three letter tag, like "UNT" or "MAP". Tags are
+// packed into a number by Tag(), so loaders can switch on them.
+//
+// Anything that doesn't parse is reported with its file, line and column, and
+// the line is marked bad. See LineParser.Error().
+
+// "UNT" -> 'U' << 16 | 'N' << 8 | 'T'.
+constexpr uint32_t
+Tag(const char (&name)[4])
+{
+    return (uint32_t)(uint8_t)name[0] << 16 |
+           (uint32_t)(uint8_t)name[1] << 8 |
+           (uint32_t)(uint8_t)name[2];
+}
+
+uint32_t
+Tag(string_view name)
+{
+    if(name.size() < 3)
+        return 0;
+    return (uint32_t)(uint8_t)name[0] << 16 |
+           (uint32_t)(uint8_t)name[1] << 8 |
+           (uint32_t)(uint8_t)name[2];
+}
+
+struct LineParser
+{
+    string filename = "";
+    string buffer = "";     // The whole file.
+    size_t next = 0;        // Where the next line starts in it.
+
+    string_view line = {};  // The one being read.
+    int line_number = 0;
+    uint32_t tag = 0;
+    size_t column = 0;      // Where the next field starts in line.
+    bool ok = true;         // False once something on this line didn't parse.
+    int errors = 0;         // In the whole file.
+
+    bool
+    Open(const string &filename_in)
+    {
+        filename = filename_in;
+        ifstream fp(filename, ios::binary | ios::ate);
+        if(!fp.is_open())
+            return false;
+
+        buffer.resize((size_t)fp.tellg());
+        fp.seekg(0);
+        fp.read(&buffer[0], buffer.size());
+        next = 0;
+        line_number = 0;
+        errors = 0;
+        return (bool)fp;
+    }
+
+    // On to the next line with anything on it. False at the end of the file.
+    bool
+    NextLine()
+    {
+        while(next < buffer.size())
+        {
+            size_t end = buffer.find('\n', next);
+            if(end == string::npos)
+                end = buffer.size();
+
+            line = string_view(buffer).substr(next, end - next);
+            if(!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            next = end + 1;
+            ++line_number;
+
+            if(line.empty())
+                continue;
+
+            tag = Tag(line);
+            column = min((size_t)4, line.size()); // The tag, and what follows it.
+            ok = true;
+            return true;
+        }
+        return false;
+    }
+
+    // Everything after the tag.
+    string_view
+    Rest() const
+    {
+        return line.substr(min((size_t)4, line.size()));
+    }
+
+    // The next field, up to sep. Runs of sep count as one, as do any at the
+    // start. Empty once the line runs out.
+    string_view
+    Field(char sep)
+    {
+        while(column < line.size() && line[column] == sep)
+            ++column;
+        size_t start = column;
+        while(column < line.size() && line[column] != sep)
+            ++column;
+        return line.substr(start, column - start);
+    }
+
+    // The next field, as a number. 0 if it isn't one.
+    int
+    Int(char sep)
+    {
+        while(column < line.size() && line[column] == sep)
+            ++column;
+        size_t start = column;
+        string_view field = Field(sep);
+
+        int result = 0;
+        from_chars_result parsed = from_chars(field.data(), field.data() + field.size(), result);
+        if(field.empty() || parsed.ec != errc() || parsed.ptr != field.data() + field.size())
+        {
+            Error(field.empty() ? "Expected a number, found the end of the line"
+                                : "Expected a number", start);
+            return 0;
+        }
+        return result;
+    }
+
+    // Reports a problem at the given column of this line, and marks it bad.
+    void
+    Error(const char *what, size_t at)
+    {
+        cout << "ERROR " << filename << ":" << line_number << ":" << at + 1 << ": " << what;
+        if(at < line.size())
+            cout << ", at \"" << line.substr(at, min((size_t)16, line.size() - at)) << "\"";
+        cout << "\n";
+        ok = false;
+        ++errors;
+    }
+
+    void
+    Error(const char *what)
+    {
+        Error(what, 0);
+    }
+
+    // Something worth mentioning about this line, but that doesn't stop it.
+    void
+    Warn(const char *what) const
+    {
+        cout << "WARN " << what << " in " << filename << ":" << line_number
+             << ": " << line.substr(0, 3) << "\n";
+    }
+};
+
+#endif
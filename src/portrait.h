@@ -0,0 +1,188 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Portrait
+
+#ifndef PORTRAIT_H
+#define PORTRAIT_H
+
+#include <list>
+
+// ================================= Portraits =================================
+// Portraits are four megabytes apiece once they're decoded, and most of them
+// aren't on screen most of the time. So units only carry their portraits'
+// names (see TextureReference()), and the images are loaded the first time
+// something draws them, or ahead of time when a level lists its
+// conversations. Once they're over budget, the least recently used are let
+// go.
+//
+// Prefetched portraits are decoded on the workers (see TextureCache.Request())
+// and uploaded by Update(), a few a frame, so a level starting doesn't wait
+// on them. Drawing one that hasn't arrived yet loads it on the spot.
+//
+// NOTE: Letting go only drops the cache's hold. Anything else still holding
+// the texture (see texture.h) keeps it around until it's done.
+
+struct PortraitCache
+{
+    struct Entry
+    {
+        string key;
+        Texture texture;    // Just the name, until it's loaded.
+        int bytes;
+        bool loaded;
+    };
+
+    list<Entry> entries = {}; // Most recently used first.
+    unordered_map<string, list<Entry>::iterator> index = {};
+    int64_t bytes = 0;
+    int64_t budget = PORTRAIT_BUDGET_MB * 1024 * 1024;
+    int hits = 0;
+    int loads = 0;
+    int evictions = 0;
+
+    // The portrait, loaded. Loads it now if it isn't already.
+    Texture
+    Get(const Texture &reference)
+    {
+        Entry *entry = Touch(reference, true);
+        return entry ? entry->texture : reference;
+    }
+
+    // Starts loading the portrait ahead of being drawn, if it isn't already.
+    void
+    Prefetch(const Texture &reference)
+    {
+        Touch(reference, false);
+    }
+
+    // Uploads prefetched portraits that have finished decoding, while there's
+    // time this frame.
+    void
+    Update()
+    {
+        for(Entry &entry : entries)
+        {
+            if(!GlobalTextureCache.CanUpload())
+                return;
+            if(!entry.loaded && GlobalTextureCache.Decoded(entry.key))
+                Fill(&entry);
+        }
+        Trim();
+    }
+
+    // Lets go of the least recently used until it's under budget. The two
+    // most recent stay either way, since a conversation shows two at once.
+    void
+    Trim()
+    {
+        while(bytes > budget && entries.size() > 2)
+        {
+            const Entry &oldest = entries.back();
+            if(!oldest.loaded)
+                GlobalTextureCache.Cancel(oldest.key);
+            bytes -= oldest.bytes;
+            index.erase(oldest.key);
+            entries.pop_back();
+            ++evictions;
+        }
+    }
+
+    void
+    Clear()
+    {
+        for(const Entry &entry : entries)
+            if(!entry.loaded)
+                GlobalTextureCache.Cancel(entry.key);
+        entries.clear();
+        index.clear();
+        bytes = 0;
+    }
+
+private:
+    Entry *
+    Touch(const Texture &reference, bool now)
+    {
+        if(reference.filename.empty())
+            return nullptr;
+
+        string key = reference.dir + reference.filename;
+        auto found = index.find(key);
+        if(found != index.end())
+        {
+            entries.splice(entries.begin(), entries, found->second);
+            ++hits;
+        }
+        else
+        {
+            entries.push_front({key, reference, 0, false});
+            index[key] = entries.begin();
+            if(!now)
+                GlobalTextureCache.Request(reference.dir, reference.filename);
+        }
+
+        Entry *entry = &entries.front();
+        if(now && !entry->loaded)
+            Fill(entry);
+        Trim();
+        return entry;
+    }
+
+    void
+    Fill(Entry *entry)
+    {
+        entry->texture = LoadTextureImage(entry->texture.dir, entry->texture.filename);
+        entry->bytes = entry->texture.resource ? entry->texture.resource->bytes
+                                               : entry->texture.width * entry->texture.height * 4;
+        entry->loaded = true;
+        bytes += entry->bytes;
+        ++loads;
+    }
+};
+
+static PortraitCache GlobalPortraits;
+
+// The unit's portrait for the expression, as named. Not necessarily loaded.
+const Texture &
+PortraitOf(const Unit &unit, Expression expression)
+{
+    switch(expression)
+    {
+        case EXPR_NEUTRAL: return unit.neutral;
+        case EXPR_HAPPY: return unit.happy;
+        case EXPR_ANGRY: return unit.angry;
+        case EXPR_WINCE: return unit.wince;
+        default: SDL_assert(!"ERROR PortraitOf: Invalid expression."); return unit.neutral;
+    }
+}
+
+// Starts loading every portrait the level's conversations will show. The
+// prelude goes last, so it's the least likely to be let go, since it's up
+// first.
+void
+PrefetchPortraits(const ConversationList &conversations)
+{
+    vector<const Conversation *> order = {};
+    for(const Conversation &conversation : conversations.list)
+        order.push_back(&conversation);
+    for(const Conversation &conversation : conversations.villages)
+        order.push_back(&conversation);
+    for(const Conversation &conversation : conversations.mid_battle)
+        order.push_back(&conversation);
+    order.push_back(&conversations.prelude);
+
+    for(const Conversation *conversation : order)
+    {
+        if(!conversation->one || !conversation->two)
+            continue;
+        GlobalPortraits.Prefetch(conversation->one->neutral);
+        GlobalPortraits.Prefetch(conversation->two->neutral);
+        for(const Sentence &sentence : conversation->prose)
+        {
+            const Unit *speaker = sentence.speaker == SPEAKER_ONE ? conversation->one
+                                                                  : conversation->two;
+            GlobalPortraits.Prefetch(PortraitOf(*speaker, sentence.expression));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,432 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Predict
+
+#ifndef PREDICT_H
+#define PREDICT_H
+
+// Kernels are picked when the game runs, not when it's built. On x86 the SSE2
+// kernel is always there, and the AVX2 one is compiled alongside it for the
+// machines that have it. See PredictKernels().
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(__ARM_NEON)
+#include <immintrin.h>
+#define PREDICT_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PREDICT_AVX2 __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define PREDICT_AVX2
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PREDICT_NEON 1
+#endif
+
+// ============================= Batched Prediction ============================
+// PredictCombat for many pairs at once. Everything the formulas need is read
+// off of the units once, in Add(), into flat arrays. The kernels then work
+// several pairs per instruction, with no pointers to chase.
+//
+// NOTE: Must agree with PredictCombat exactly, down to its quirks. The avoid
+// bonus is taken off of the hit chance twice, and Avoid() ignores speed buffs.
+
+// What the formulas need to know about one unit. Read off once per unit,
+// rather than once per pair it shows up in.
+struct CombatantStats
+{
+    int attack;  // Attack(), plus any attack buff.
+    int defense; // defense, plus any defense buff.
+    int hit;
+    int avoid;
+    int crit;
+    int speed;   // AttackSpeed(), plus any speed buff.
+    int min_range;
+    int max_range;
+
+    static CombatantStats
+    From(const Unit &unit)
+    {
+        const DerivedStats &d = unit.derived;
+        return {d.buffed_attack, d.buffed_defense, d.hit, d.avoid, d.crit,
+                d.buffed_speed, d.min_range, d.max_range};
+    }
+};
+
+// One column per field, one row per pair.
+struct CombatBatch
+{
+    // The attacker
+    vector<int> one_attack = {};  // Attack(), plus any attack buff.
+    vector<int> one_defense = {}; // defense, plus any defense buff.
+    vector<int> one_hit = {};
+    vector<int> one_avoid = {};
+    vector<int> one_crit = {};
+    vector<int> one_speed = {};   // AttackSpeed(), plus any speed buff.
+
+    // The defender
+    vector<int> two_attack = {};
+    vector<int> two_defense = {};
+    vector<int> two_hit = {};
+    vector<int> two_avoid = {};
+    vector<int> two_crit = {};
+    vector<int> two_speed = {};
+    vector<int> two_min_range = {};
+    vector<int> two_max_range = {};
+
+    // The ground between them
+    vector<int> distance = {};
+    vector<int> one_avoid_bonus = {};
+    vector<int> two_avoid_bonus = {};
+    vector<int> one_defense_bonus = {};
+    vector<int> two_defense_bonus = {};
+
+    int
+    Size() const
+    {
+        return (int)distance.size();
+    }
+
+    void
+    Clear()
+    {
+        for(vector<int> *column : Columns())
+            column->clear();
+    }
+
+    void
+    Reserve(int count)
+    {
+        for(vector<int> *column : Columns())
+            column->reserve(count);
+    }
+
+    // Same arguments as PredictCombat.
+    void
+    Add(const Unit &one, const Unit &two, int distance_in,
+        int one_avoid_bonus_in, int two_avoid_bonus_in,
+        int one_defense_bonus_in, int two_defense_bonus_in)
+    {
+        Add(CombatantStats::From(one), CombatantStats::From(two), distance_in,
+            one_avoid_bonus_in, two_avoid_bonus_in,
+            one_defense_bonus_in, two_defense_bonus_in);
+    }
+
+    void
+    Add(const CombatantStats &one, const CombatantStats &two, int distance_in,
+        int one_avoid_bonus_in, int two_avoid_bonus_in,
+        int one_defense_bonus_in, int two_defense_bonus_in)
+    {
+        one_attack.push_back(one.attack);
+        one_defense.push_back(one.defense);
+        one_hit.push_back(one.hit);
+        one_avoid.push_back(one.avoid);
+        one_crit.push_back(one.crit);
+        one_speed.push_back(one.speed);
+
+        two_attack.push_back(two.attack);
+        two_defense.push_back(two.defense);
+        two_hit.push_back(two.hit);
+        two_avoid.push_back(two.avoid);
+        two_crit.push_back(two.crit);
+        two_speed.push_back(two.speed);
+        two_min_range.push_back(two.min_range);
+        two_max_range.push_back(two.max_range);
+
+        distance.push_back(distance_in);
+        one_avoid_bonus.push_back(one_avoid_bonus_in);
+        two_avoid_bonus.push_back(two_avoid_bonus_in);
+        one_defense_bonus.push_back(one_defense_bonus_in);
+        two_defense_bonus.push_back(two_defense_bonus_in);
+    }
+
+private:
+    vector<vector<int> *>
+    Columns()
+    {
+        return {&one_attack, &one_defense, &one_hit, &one_avoid, &one_crit, &one_speed,
+                &two_attack, &two_defense, &two_hit, &two_avoid, &two_crit, &two_speed,
+                &two_min_range, &two_max_range,
+                &distance, &one_avoid_bonus, &two_avoid_bonus,
+                &one_defense_bonus, &two_defense_bonus};
+    }
+};
+
+// The Outcome fields, one column each. Flags are 0 or 1.
+struct OutcomeBatch
+{
+    vector<int> one_damage = {};
+    vector<int> one_hit = {};
+    vector<int> one_crit = {};
+    vector<int> one_doubles = {};
+    vector<int> two_attacks = {};
+    vector<int> two_damage = {};
+    vector<int> two_hit = {};
+    vector<int> two_crit = {};
+    vector<int> two_doubles = {};
+
+    void
+    Resize(int count)
+    {
+        for(vector<int> *column : {&one_damage, &one_hit, &one_crit, &one_doubles,
+                                   &two_attacks, &two_damage, &two_hit, &two_crit,
+                                   &two_doubles})
+            column->resize(count);
+    }
+
+    Outcome
+    Get(int i) const
+    {
+        Outcome outcome = {};
+        outcome.one_attacks = true;
+        outcome.one_doubles = one_doubles[i];
+        outcome.one_damage = one_damage[i];
+        outcome.one_hit = one_hit[i];
+        outcome.one_crit = one_crit[i];
+        outcome.two_attacks = two_attacks[i];
+        outcome.two_doubles = two_doubles[i];
+        outcome.two_damage = two_damage[i];
+        outcome.two_hit = two_hit[i];
+        outcome.two_crit = two_crit[i];
+        return outcome;
+    }
+};
+
+// One pair, the plain way. Finishes off whatever the kernels leave over.
+void
+PredictCombatRow(const CombatBatch &in, int i, OutcomeBatch *out)
+{
+    out->one_damage[i] = clamp(in.one_attack[i] - (in.two_defense[i] + in.two_defense_bonus[i]), 0, 999);
+    out->one_hit[i] = in.one_hit[i] - (in.two_avoid[i] + in.two_avoid_bonus[i]) - in.two_avoid_bonus[i];
+    out->one_crit[i] = in.one_crit[i];
+    out->one_doubles[i] = in.one_speed[i] - in.two_speed[i] > DOUBLE_RATIO;
+
+    bool two_attacks = in.distance[i] >= in.two_min_range[i] &&
+                       in.distance[i] <= in.two_max_range[i];
+    out->two_attacks[i] = two_attacks;
+    out->two_damage[i] = two_attacks ? clamp(in.two_attack[i] - (in.one_defense[i] + in.one_defense_bonus[i]), 0, 999) : 0;
+    out->two_hit[i] = two_attacks ? in.two_hit[i] - (in.one_avoid[i] + in.one_avoid_bonus[i]) - in.one_avoid_bonus[i] : 0;
+    out->two_crit[i] = two_attacks ? in.two_crit[i] : 0;
+    out->two_doubles[i] = two_attacks && in.two_speed[i] - in.one_speed[i] > DOUBLE_RATIO;
+}
+
+// Every pair through PredictCombatRow. What the kernels are checked against.
+void
+PredictCombatBatchScalar(const CombatBatch &in, OutcomeBatch *out)
+{
+    out->Resize(in.Size());
+    for(int i = 0; i < in.Size(); ++i)
+        PredictCombatRow(in, i, out);
+}
+
+// ================================== Kernels ==================================
+// Each works whole groups of lanes, from the front. PredictCombatBatch does the
+// rows left over at the end.
+
+#if defined(PREDICT_AVX2)
+#define LOAD(column) _mm256_loadu_si256((const __m256i *)&in.column[i])
+#define STORE(column, value) _mm256_storeu_si256((__m256i *)&out->column[i], value)
+
+PREDICT_AVX2
+void
+PredictCombatKernelAVX2(const CombatBatch &in, OutcomeBatch *out, int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i most = _mm256_set1_epi32(999);
+    const __m256i ratio = _mm256_set1_epi32(DOUBLE_RATIO);
+
+    for(int i = 0; i + 8 <= count; i += 8)
+    {
+        __m256i one_damage = _mm256_sub_epi32(LOAD(one_attack), _mm256_add_epi32(LOAD(two_defense), LOAD(two_defense_bonus)));
+        one_damage = _mm256_min_epi32(_mm256_max_epi32(one_damage, zero), most);
+        __m256i two_bonus = LOAD(two_avoid_bonus);
+        __m256i one_hit = _mm256_sub_epi32(_mm256_sub_epi32(LOAD(one_hit), _mm256_add_epi32(LOAD(two_avoid), two_bonus)), two_bonus);
+        __m256i speed = _mm256_sub_epi32(LOAD(one_speed), LOAD(two_speed));
+        __m256i one_doubles = _mm256_and_si256(_mm256_cmpgt_epi32(speed, ratio), one);
+
+        __m256i distance = LOAD(distance);
+        __m256i out_of_range = _mm256_or_si256(_mm256_cmpgt_epi32(LOAD(two_min_range), distance),
+                                               _mm256_cmpgt_epi32(distance, LOAD(two_max_range)));
+        __m256i two_damage = _mm256_sub_epi32(LOAD(two_attack), _mm256_add_epi32(LOAD(one_defense), LOAD(one_defense_bonus)));
+        two_damage = _mm256_min_epi32(_mm256_max_epi32(two_damage, zero), most);
+        __m256i one_bonus = LOAD(one_avoid_bonus);
+        __m256i two_hit = _mm256_sub_epi32(_mm256_sub_epi32(LOAD(two_hit), _mm256_add_epi32(LOAD(one_avoid), one_bonus)), one_bonus);
+        __m256i two_doubles = _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_sub_epi32(zero, speed), ratio), one);
+
+        STORE(one_damage, one_damage);
+        STORE(one_hit, one_hit);
+        STORE(one_crit, LOAD(one_crit));
+        STORE(one_doubles, one_doubles);
+        STORE(two_attacks, _mm256_andnot_si256(out_of_range, one));
+        STORE(two_damage, _mm256_andnot_si256(out_of_range, two_damage));
+        STORE(two_hit, _mm256_andnot_si256(out_of_range, two_hit));
+        STORE(two_crit, _mm256_andnot_si256(out_of_range, LOAD(two_crit)));
+        STORE(two_doubles, _mm256_andnot_si256(out_of_range, two_doubles));
+    }
+}
+#undef LOAD
+#undef STORE
+#endif
+
+#if defined(PREDICT_SSE2)
+#define LOAD(column) _mm_loadu_si128((const __m128i *)&in.column[i])
+#define STORE(column, value) _mm_storeu_si128((__m128i *)&out->column[i], value)
+
+// SSE2 has no 32-bit min or max. Pick with a compare instead.
+static inline __m128i
+Clamp128(__m128i value, __m128i low, __m128i high)
+{
+    __m128i under = _mm_cmpgt_epi32(low, value);
+    value = _mm_or_si128(_mm_and_si128(under, low), _mm_andnot_si128(under, value));
+    __m128i over = _mm_cmpgt_epi32(value, high);
+    return _mm_or_si128(_mm_and_si128(over, high), _mm_andnot_si128(over, value));
+}
+
+void
+PredictCombatKernelSSE2(const CombatBatch &in, OutcomeBatch *out, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i most = _mm_set1_epi32(999);
+    const __m128i ratio = _mm_set1_epi32(DOUBLE_RATIO);
+
+    for(int i = 0; i + 4 <= count; i += 4)
+    {
+        __m128i one_damage = _mm_sub_epi32(LOAD(one_attack), _mm_add_epi32(LOAD(two_defense), LOAD(two_defense_bonus)));
+        one_damage = Clamp128(one_damage, zero, most);
+        __m128i two_bonus = LOAD(two_avoid_bonus);
+        __m128i one_hit = _mm_sub_epi32(_mm_sub_epi32(LOAD(one_hit), _mm_add_epi32(LOAD(two_avoid), two_bonus)), two_bonus);
+        __m128i speed = _mm_sub_epi32(LOAD(one_speed), LOAD(two_speed));
+        __m128i one_doubles = _mm_and_si128(_mm_cmpgt_epi32(speed, ratio), one);
+
+        __m128i distance = LOAD(distance);
+        __m128i out_of_range = _mm_or_si128(_mm_cmpgt_epi32(LOAD(two_min_range), distance),
+                                            _mm_cmpgt_epi32(distance, LOAD(two_max_range)));
+        __m128i two_damage = _mm_sub_epi32(LOAD(two_attack), _mm_add_epi32(LOAD(one_defense), LOAD(one_defense_bonus)));
+        two_damage = Clamp128(two_damage, zero, most);
+        __m128i one_bonus = LOAD(one_avoid_bonus);
+        __m128i two_hit = _mm_sub_epi32(_mm_sub_epi32(LOAD(two_hit), _mm_add_epi32(LOAD(one_avoid), one_bonus)), one_bonus);
+        __m128i two_doubles = _mm_and_si128(_mm_cmpgt_epi32(_mm_sub_epi32(zero, speed), ratio), one);
+
+        STORE(one_damage, one_damage);
+        STORE(one_hit, one_hit);
+        STORE(one_crit, LOAD(one_crit));
+        STORE(one_doubles, one_doubles);
+        STORE(two_attacks, _mm_andnot_si128(out_of_range, one));
+        STORE(two_damage, _mm_andnot_si128(out_of_range, two_damage));
+        STORE(two_hit, _mm_andnot_si128(out_of_range, two_hit));
+        STORE(two_crit, _mm_andnot_si128(out_of_range, LOAD(two_crit)));
+        STORE(two_doubles, _mm_andnot_si128(out_of_range, two_doubles));
+    }
+}
+#undef LOAD
+#undef STORE
+#endif
+
+#if defined(PREDICT_NEON)
+#define LOAD(column) vld1q_s32(&in.column[i])
+#define STORE(column, value) vst1q_s32(&out->column[i], value)
+
+void
+PredictCombatKernelNEON(const CombatBatch &in, OutcomeBatch *out, int count)
+{
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t one = vdupq_n_s32(1);
+    const int32x4_t most = vdupq_n_s32(999);
+    const int32x4_t ratio = vdupq_n_s32(DOUBLE_RATIO);
+
+    for(int i = 0; i + 4 <= count; i += 4)
+    {
+        int32x4_t one_damage = vsubq_s32(LOAD(one_attack), vaddq_s32(LOAD(two_defense), LOAD(two_defense_bonus)));
+        one_damage = vminq_s32(vmaxq_s32(one_damage, zero), most);
+        int32x4_t two_bonus = LOAD(two_avoid_bonus);
+        int32x4_t one_hit = vsubq_s32(vsubq_s32(LOAD(one_hit), vaddq_s32(LOAD(two_avoid), two_bonus)), two_bonus);
+        int32x4_t speed = vsubq_s32(LOAD(one_speed), LOAD(two_speed));
+        int32x4_t one_doubles = vandq_s32(vreinterpretq_s32_u32(vcgtq_s32(speed, ratio)), one);
+
+        int32x4_t distance = LOAD(distance);
+        int32x4_t in_range = vreinterpretq_s32_u32(vandq_u32(vcgeq_s32(distance, LOAD(two_min_range)),
+                                                             vcleq_s32(distance, LOAD(two_max_range))));
+        int32x4_t two_damage = vsubq_s32(LOAD(two_attack), vaddq_s32(LOAD(one_defense), LOAD(one_defense_bonus)));
+        two_damage = vminq_s32(vmaxq_s32(two_damage, zero), most);
+        int32x4_t one_bonus = LOAD(one_avoid_bonus);
+        int32x4_t two_hit = vsubq_s32(vsubq_s32(LOAD(two_hit), vaddq_s32(LOAD(one_avoid), one_bonus)), one_bonus);
+        int32x4_t two_doubles = vandq_s32(vreinterpretq_s32_u32(vcgtq_s32(vnegq_s32(speed), ratio)), one);
+
+        STORE(one_damage, one_damage);
+        STORE(one_hit, one_hit);
+        STORE(one_crit, LOAD(one_crit));
+        STORE(one_doubles, one_doubles);
+        STORE(two_attacks, vandq_s32(in_range, one));
+        STORE(two_damage, vandq_s32(in_range, two_damage));
+        STORE(two_hit, vandq_s32(in_range, two_hit));
+        STORE(two_crit, vandq_s32(in_range, LOAD(two_crit)));
+        STORE(two_doubles, vandq_s32(in_range, two_doubles));
+    }
+}
+#undef LOAD
+#undef STORE
+#endif
+
+// One lane, for machines with none of the above.
+void
+PredictCombatKernelScalar(const CombatBatch &in, OutcomeBatch *out, int count)
+{
+    for(int i = 0; i < count; ++i)
+        PredictCombatRow(in, i, out);
+}
+
+struct PredictKernel
+{
+    const char *name;
+    int lanes;
+    void (*run)(const CombatBatch &in, OutcomeBatch *out, int count);
+};
+
+// Every kernel this machine can run, widest first. The last is always scalar.
+vector<PredictKernel>
+PredictKernels()
+{
+    vector<PredictKernel> kernels = {};
+#if defined(PREDICT_AVX2)
+#if defined(__GNUC__) && !defined(__AVX2__)
+    if(__builtin_cpu_supports("avx2"))
+#endif
+        kernels.push_back({"avx2", 8, PredictCombatKernelAVX2});
+#endif
+#if defined(PREDICT_SSE2)
+    kernels.push_back({"sse2", 4, PredictCombatKernelSSE2});
+#endif
+#if defined(PREDICT_NEON)
+    kernels.push_back({"neon", 4, PredictCombatKernelNEON});
+#endif
+    kernels.push_back({"scalar", 1, PredictCombatKernelScalar});
+    return kernels;
+}
+
+// The widest one, picked the first time it's asked for.
+const PredictKernel &
+BestPredictKernel()
+{
+    static const PredictKernel best = PredictKernels().front();
+    return best;
+}
+
+// PredictCombat for every pair in the batch, with the given kernel.
+void
+PredictCombatBatch(const CombatBatch &in, OutcomeBatch *out, const PredictKernel &kernel)
+{
+    int count = in.Size();
+    out->Resize(count);
+    kernel.run(in, out, count);
+    for(int i = count - count % kernel.lanes; i < count; ++i)
+        PredictCombatRow(in, i, out);
+}
+
+// PredictCombat for every pair in the batch.
+void
+PredictCombatBatch(const CombatBatch &in, OutcomeBatch *out)
+{
+    PredictCombatBatch(in, out, BestPredictKernel());
+}
+
+#endif
@@ -0,0 +1,204 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Profiler
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <fstream>
+#include <sys/stat.h>
+
+// ================================ AI Profiler ================================
+// Breaks each AI unit's decision down by where the time went, and keeps the
+// last AI_PROFILE_ENTRIES of them around for the editor to show.
+//
+// A decision runs from AISelectUnitCommand to AIPerformUnitActionCommand.
+// Only the time spent inside those two counts, not the frames in between.
+// Sections are exclusive. Time in a path that FindNearest asked for is
+// charged to PROFILE_PATHS, not to PROFILE_NEAREST.
+
+string
+GetProfileSectionString(ProfileSection section)
+{
+    switch(section)
+    {
+        case PROFILE_OTHER:             return "other";
+        case PROFILE_MOVEMENT:          return "movement";
+        case PROFILE_ATTACKING_SQUARES: return "attack squares";
+        case PROFILE_NEAREST:           return "nearest";
+        case PROFILE_PATHS:             return "paths";
+        case PROFILE_INFLUENCE:         return "influence";
+        case PROFILE_SCORING:           return "scoring";
+        case PROFILE_ROLLOUT:           return "rollout";
+        default: SDL_assert(!"ERROR Unhandled enum in GetProfileSectionString"); return "";
+    }
+}
+
+// One unit's decision.
+struct AIDecisionProfile
+{
+    int sequence = 0;
+    string unit = "";
+    int turn = 0;
+    double section_us[PROFILE_SECTIONS] = {};
+    int nodes = 0;      // Tiles popped off of a search's queue.
+    int candidates = 0; // Squares and targets weighed up.
+    bool cached = false; // The action came out of GlobalActionCache.
+
+    double
+    Total() const
+    {
+        double total = 0.0;
+        for(int i = 0; i < PROFILE_SECTIONS; ++i)
+            total += section_us[i];
+        return total;
+    }
+};
+
+struct ProfileScope;
+
+struct AIProfiler
+{
+    vector<AIDecisionProfile> ring = vector<AIDecisionProfile>(AI_PROFILE_ENTRIES);
+    int next = 0;
+    int count = 0;
+    int sequence = 0;
+
+    bool recording = false;
+    AIDecisionProfile current = {};
+    ProfileScope *open = nullptr; // Innermost running scope.
+
+    void
+    BeginDecision(const string &unit, int turn)
+    {
+        current = {};
+        current.sequence = sequence++;
+        current.unit = unit;
+        current.turn = turn;
+        recording = true;
+    }
+
+    void
+    EndDecision()
+    {
+        if(!recording)
+            return;
+        recording = false;
+        ring[next] = current;
+        next = (next + 1) % AI_PROFILE_ENTRIES;
+        count = min(count + 1, AI_PROFILE_ENTRIES);
+    }
+
+    void
+    CountNode()
+    {
+        if(recording)
+            ++current.nodes;
+    }
+
+    void
+    CountCandidates(int amount)
+    {
+        if(recording)
+            current.candidates += amount;
+    }
+
+    void
+    MarkCached()
+    {
+        if(recording)
+            current.cached = true;
+    }
+
+    // The i-th oldest decision still remembered.
+    const AIDecisionProfile &
+    Get(int i) const
+    {
+        return ring[(next - count + i + AI_PROFILE_ENTRIES) % AI_PROFILE_ENTRIES];
+    }
+
+    void
+    Clear()
+    {
+        next = 0;
+        count = 0;
+    }
+
+    // Writes every remembered decision out as a tab-separated table.
+    // Returns the file's name, or "" if it couldn't be written.
+    string
+    Export() const
+    {
+        mkdir(LOGS_PATH, 0755);
+        string filename = string(LOGS_PATH) + "ai-profile-" + to_string(time(nullptr)) + ".tsv";
+
+        ofstream fp;
+        fp.open(filename);
+        if(!fp.is_open())
+        {
+            cout << "WARN AIProfiler.Export: Couldn't open " << filename << "\n";
+            return "";
+        }
+
+        fp << "sequence\tunit\tturn\ttotal_us";
+        for(int section = 0; section < PROFILE_SECTIONS; ++section)
+        {
+            string name = GetProfileSectionString((ProfileSection)section);
+            replace(name.begin(), name.end(), ' ', '_');
+            fp << "\t" << name << "_us";
+        }
+        fp << "\tnodes\tcandidates\tcached\n";
+
+        for(int i = 0; i < count; ++i)
+        {
+            const AIDecisionProfile &decision = Get(i);
+            fp << decision.sequence << "\t" << decision.unit << "\t"
+               << decision.turn << "\t" << decision.Total();
+            for(int section = 0; section < PROFILE_SECTIONS; ++section)
+                fp << "\t" << decision.section_us[section];
+            fp << "\t" << decision.nodes << "\t" << decision.candidates << "\t"
+               << decision.cached << "\n";
+        }
+        fp.close();
+        return filename;
+    }
+};
+
+// NOTE: One per thread, like the AI caches.
+static thread_local AIProfiler GlobalAIProfiler;
+
+// Charges the time until it goes out of scope to one section, minus whatever
+// the scopes opened inside of it took. Free when nothing is being recorded.
+struct ProfileScope
+{
+    ProfileSection section;
+    bool active;
+    ProfileScope *parent = nullptr;
+    double children_us = 0.0;
+    chrono::steady_clock::time_point start;
+
+    ProfileScope(ProfileSection section_in)
+    : section(section_in),
+      active(GlobalAIProfiler.recording)
+    {
+        if(!active)
+            return;
+        parent = GlobalAIProfiler.open;
+        GlobalAIProfiler.open = this;
+        start = chrono::steady_clock::now();
+    }
+
+    ~ProfileScope()
+    {
+        if(!active)
+            return;
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        GlobalAIProfiler.current.section_us[section] += us - children_us;
+        if(parent)
+            parent->children_us += us;
+        GlobalAIProfiler.open = parent;
+    }
+};
+
+#endif
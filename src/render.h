@@ -33,33 +33,34 @@ RenderTileTexture(const Tilemap &map, const Tile &tile,
     SDL_RenderCopy(GlobalRenderer, map.atlas.sdl_texture, &source, &destination);
 }
 
-// Sets color modifiers based on the unit's properties.
-void
-SetSpriteModifiers(Unit *unit)
+// The color a unit's sprite is tinted, based on its properties.
+SDL_Color
+SpriteModifier(const Unit &unit)
 {
-    if(unit->is_exhausted)
+    SDL_Color result = readyMod;
+    if(unit.is_exhausted)
     {
-        SDL_SetTextureColorMod(unit->sheet.texture.sdl_texture, exhaustedMod.r, exhaustedMod.g, exhaustedMod.b);
+        result = exhaustedMod;
     }
-    else if(unit->buff)
+    else if(unit.buff)
     {
-        switch(unit->buff->stat)
+        switch(unit.buff->stat)
         {
             case STAT_ATTACK:
             {
-                SDL_SetTextureColorMod(unit->sheet.texture.sdl_texture, buffAtkMod.r, buffAtkMod.g, buffAtkMod.b);
+                result = buffAtkMod;
             } break;
             case STAT_DEFENSE:
             {
-                SDL_SetTextureColorMod(unit->sheet.texture.sdl_texture, buffDefMod.r, buffDefMod.g, buffDefMod.b);
+                result = buffDefMod;
             } break;
             case STAT_MAGIC:
             {
-                SDL_SetTextureColorMod(unit->sheet.texture.sdl_texture, buffMagMod.r, buffMagMod.g, buffMagMod.b);
+                result = buffMagMod;
             } break;
             case STAT_SPEED:
             {
-                SDL_SetTextureColorMod(unit->sheet.texture.sdl_texture, buffSpdMod.r, buffSpdMod.g, buffSpdMod.b);
+                result = buffSpdMod;
             } break;
             default:
             {
@@ -67,14 +68,84 @@ SetSpriteModifiers(Unit *unit)
             } break;
         }
     }
-    else if(unit->is_boss)
+    else if(unit.is_boss)
     {
-        SDL_SetTextureColorMod(unit->sheet.texture.sdl_texture, buffAtkMod.r, buffAtkMod.g, buffAtkMod.b);
+        result = buffAtkMod;
+    }
+    result.a = 255; // NOTE: The modifiers only tint.
+    return result;
+}
+
+// ================================ Sprite Batch ===============================
+// Sprites queued up and drawn together with SDL_RenderGeometry, a draw for
+// each run on the same texture. Units off the atlas (see atlas.h) all share
+// one, so the whole map is usually one draw. Tints go on the vertices, since
+// a color mod on the texture would tint everyone on it.
+struct SpriteBatch
+{
+    SDL_Texture *texture = nullptr;
+    float width = 0.0f;
+    float height = 0.0f;
+    vector<SDL_Vertex> vertices = {};
+    vector<int> indices = {};
+
+    void
+    Add(const Spritesheet &sheet, const SDL_Rect &destination, SDL_Color color, bool flipped)
+    {
+        if(sheet.texture.sdl_texture != texture)
+        {
+            Flush();
+            texture = sheet.texture.sdl_texture;
+            width = (float)sheet.texture.width;
+            height = (float)sheet.texture.height;
+        }
+
+        SDL_Rect source = sheet.Frame();
+        float left = source.x / width;
+        float right = (source.x + source.w) / width;
+        float top = source.y / height;
+        float bottom = (source.y + source.h) / height;
+        if(flipped)
+            swap(left, right);
+
+        float x = (float)destination.x;
+        float y = (float)destination.y;
+        float w = (float)destination.w;
+        float h = (float)destination.h;
+        int first = (int)vertices.size();
+        vertices.push_back({{x, y}, color, {left, top}});
+        vertices.push_back({{x + w, y}, color, {right, top}});
+        vertices.push_back({{x, y + h}, color, {left, bottom}});
+        vertices.push_back({{x + w, y + h}, color, {right, bottom}});
+        for(int corner : {0, 1, 2, 2, 1, 3})
+            indices.push_back(first + corner);
     }
-    else
+
+    void
+    Flush()
     {
-        SDL_SetTextureColorMod(unit->sheet.texture.sdl_texture, readyMod.r, readyMod.g, readyMod.b);
+        if(!vertices.empty())
+            SDL_RenderGeometry(GlobalRenderer, texture, vertices.data(), (int)vertices.size(),
+                               indices.data(), (int)indices.size());
+        vertices.clear();
+        indices.clear();
+        texture = nullptr;
     }
+};
+
+static SpriteBatch GlobalSpriteBatch;
+
+// Where an animation offset is drawn this frame, between the last two ticks.
+// Offsets go back to zero when something reaches the next tile, so a jump that
+// big is drawn as is.
+position
+Interpolate(const position &last, const position &current)
+{
+    if(abs(current.col - last.col) > TILE_SIZE / 2 || abs(current.row - last.row) > TILE_SIZE / 2)
+        return current;
+    float alpha = GlobalClock.Alpha();
+    return position((int)Lerp((float)last.col, (float)current.col, alpha),
+                    (int)Lerp((float)last.row, (float)current.row, alpha));
 }
 
 // Renders a sprite to the screen, given its game coords and spritesheet.
@@ -85,7 +156,7 @@ RenderSprite(const position &pos, const Spritesheet &sheet, bool flipped = false
     SDL_Rect destination = {pos.col * TILE_SIZE + animation_offset.col, 
                             pos.row * TILE_SIZE + animation_offset.row, 
                             TILE_SIZE, TILE_SIZE};
-    SDL_Rect source = {sheet.frame * sheet.size, sheet.track * sheet.size, sheet.size, sheet.size};
+    SDL_Rect source = sheet.Frame();
 
     SDL_RenderCopyEx(GlobalRenderer, sheet.texture.sdl_texture, &source, &destination,
                      0, NULL, (const SDL_RendererFlip)flipped);
@@ -96,21 +167,13 @@ void
 RenderPortrait(int x, int y, const Unit &unit, 
                Expression expression, bool flipped)
 {
-    const Texture *portrait;
-    switch(expression)
-    {
-        case EXPR_NEUTRAL: portrait = &unit.neutral; break;
-        case EXPR_HAPPY: portrait = &unit.happy; break;
-        case EXPR_ANGRY: portrait = &unit.angry; break;
-        case EXPR_WINCE: portrait = &unit.wince; break;
-        default: SDL_assert(!"ERROR RenderPortrait: Invalid expression."); break;
-    }
+    Texture portrait = GlobalPortraits.Get(PortraitOf(unit, expression));
     SDL_Rect destination = {x, y, 
                             PORTRAIT_SIZE,
                             PORTRAIT_SIZE};
-    SDL_Rect source = {0, 0, portrait->width, portrait->height};
+    SDL_Rect source = {0, 0, portrait.width, portrait.height};
 
-    SDL_RenderCopyEx(GlobalRenderer, portrait->sdl_texture, &source, &destination, 
+    SDL_RenderCopyEx(GlobalRenderer, portrait.sdl_texture, &source, &destination, 
                      0, NULL, (const SDL_RendererFlip)flipped);
 }
 
@@ -340,6 +403,7 @@ Render(const Tilemap &map, const Cursor &cursor,
     }
 
 // ================================= render sprites ================================================
+    // Every sprite goes in one batch, then the health bars go over them.
     for(int col = viewportCol; col < VIEWPORT_WIDTH + viewportCol; ++col)
     {
         for(int row = viewportRow; row < VIEWPORT_HEIGHT + viewportRow; ++row)
@@ -347,12 +411,28 @@ Render(const Tilemap &map, const Cursor &cursor,
             const Tile &tileToRender = map.tiles[col][row];
             if(tileToRender.occupant)
             {
-                position screen_pos = {col - viewportCol, row - viewportRow};
-
-                SetSpriteModifiers(tileToRender.occupant);
+                position offset = Interpolate(tileToRender.occupant->last_offset, tileToRender.occupant->animation_offset);
+                SDL_Rect destination = {(col - viewportCol) * TILE_SIZE + offset.col,
+                                        (row - viewportRow) * TILE_SIZE + offset.row,
+                                        TILE_SIZE, TILE_SIZE};
+                GlobalSpriteBatch.Add(tileToRender.occupant->sheet, destination,
+                                      SpriteModifier(*tileToRender.occupant),
+                                      tileToRender.occupant->is_ally);
+            }
+        }
+    }
+    GlobalSpriteBatch.Flush();
 
-                RenderSprite(screen_pos, tileToRender.occupant->sheet, tileToRender.occupant->is_ally, tileToRender.occupant->animation_offset);
-                RenderHealthBarSmall(screen_pos, tileToRender.occupant->health, tileToRender.occupant->max_health, tileToRender.occupant->animation_offset);
+    for(int col = viewportCol; col < VIEWPORT_WIDTH + viewportCol; ++col)
+    {
+        for(int row = viewportRow; row < VIEWPORT_HEIGHT + viewportRow; ++row)
+        {
+            const Tile &tileToRender = map.tiles[col][row];
+            if(tileToRender.occupant)
+            {
+                position screen_pos = {col - viewportCol, row - viewportRow};
+                position offset = Interpolate(tileToRender.occupant->last_offset, tileToRender.occupant->animation_offset);
+                RenderHealthBarSmall(screen_pos, tileToRender.occupant->health, tileToRender.occupant->max_health, offset);
             }
         }
     }
@@ -377,7 +457,7 @@ Render(const Tilemap &map, const Cursor &cursor,
     {
         if(WithinViewport(cursor.pos))
             RenderSprite(cursor.pos - position(viewportCol, viewportRow), 
-                         cursor.sheet, false, cursor.animation_offset);
+                         cursor.sheet, false, Interpolate(cursor.last_offset, cursor.animation_offset));
     }
 
 
@@ -0,0 +1,223 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Replay
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <fstream>
+
+// ================================== Replays ==================================
+// Records the input the game sees each tick, along with the seed it started
+// from, so that a session can be played back exactly. Headless and as fast as
+// the machine goes, if need be. See --record and --replay in main().
+//
+// Ticks are packed into runs of the same input, so the idle stretches that
+// make up most of a session cost a couple of bytes each.
+//
+// File | "EMRP", version (u32), seed (u64), ai mode (u8), then runs until the
+//        end: buttons (u8), ticks (varint).
+//
+// NOTE: Only what comes in through InputState is recorded. Changes made in
+// the editor aren't, and the rollout planner thinks against the clock, so a
+// session that used either may not play back the same.
+
+#define REPLAY_MAGIC "EMRP"
+// 2: The game menu gained "Rewind", so moving up from its top wraps onto a
+//    different option.
+#define REPLAY_VERSION 2
+
+enum ReplayButton
+{
+    REPLAY_UP     = 1 << 0,
+    REPLAY_DOWN   = 1 << 1,
+    REPLAY_LEFT   = 1 << 2,
+    REPLAY_RIGHT  = 1 << 3,
+    REPLAY_A      = 1 << 4,
+    REPLAY_B      = 1 << 5,
+    REPLAY_R      = 1 << 6,
+    REPLAY_EDITOR = 1 << 7, // GlobalEditorMode. Gameplay stops while it's up.
+};
+
+uint8_t
+PackInput(const InputState &input)
+{
+    return (input.up    ? REPLAY_UP    : 0) |
+           (input.down  ? REPLAY_DOWN  : 0) |
+           (input.left  ? REPLAY_LEFT  : 0) |
+           (input.right ? REPLAY_RIGHT : 0) |
+           (input.a     ? REPLAY_A     : 0) |
+           (input.b     ? REPLAY_B     : 0) |
+           (input.r     ? REPLAY_R     : 0) |
+           (GlobalEditorMode ? REPLAY_EDITOR : 0);
+}
+
+void
+UnpackInput(uint8_t buttons, InputState *input)
+{
+    input->up    = buttons & REPLAY_UP;
+    input->down  = buttons & REPLAY_DOWN;
+    input->left  = buttons & REPLAY_LEFT;
+    input->right = buttons & REPLAY_RIGHT;
+    input->a     = buttons & REPLAY_A;
+    input->b     = buttons & REPLAY_B;
+    input->r     = buttons & REPLAY_R;
+    GlobalEditorMode = buttons & REPLAY_EDITOR;
+}
+
+struct InputRecorder
+{
+    ofstream fp;
+    bool recording = false;
+    uint8_t buttons = 0;
+    uint32_t run = 0; // Ticks so far with these buttons.
+    int ticks = 0;
+
+    bool
+    Open(const string &filename, uint64_t seed, AIMode ai_mode)
+    {
+        fp.open(filename, ios::binary);
+        if(!fp.is_open())
+        {
+            cout << "WARN InputRecorder.Open: Couldn't open " << filename << "\n";
+            return false;
+        }
+        uint32_t version = REPLAY_VERSION;
+        uint8_t mode = ai_mode;
+        fp.write(REPLAY_MAGIC, 4);
+        fp.write((const char *)&version, sizeof(version));
+        fp.write((const char *)&seed, sizeof(seed));
+        fp.write((const char *)&mode, sizeof(mode));
+        recording = true;
+        return true;
+    }
+
+    // Called once a tick, with the input the tick is about to act on.
+    void
+    Record(const InputState &input)
+    {
+        if(!recording)
+            return;
+        uint8_t current = PackInput(input);
+        if(run && current != buttons)
+            Flush();
+        buttons = current;
+        ++run;
+        ++ticks;
+    }
+
+    void
+    Close()
+    {
+        if(!recording)
+            return;
+        if(run)
+            Flush();
+        fp.close();
+        recording = false;
+    }
+
+private:
+    void
+    Flush()
+    {
+        fp.put((char)buttons);
+        uint32_t count = run;
+        while(count >= 0x80)
+        {
+            fp.put((char)(0x80 | (count & 0x7f)));
+            count >>= 7;
+        }
+        fp.put((char)count);
+        run = 0;
+    }
+};
+
+struct InputReplay
+{
+    bool playing = false;
+    uint64_t seed = 0;
+    AIMode ai_mode = AI_MODE_GREEDY;
+    vector<pair<uint8_t, uint32_t>> runs = {}; // Buttons, and for how many ticks.
+    int ticks = 0;      // In the whole replay.
+
+    int next_run = 0;
+    uint32_t left = 0;  // Ticks left in the run being played.
+
+    bool
+    Load(const string &filename)
+    {
+        ifstream fp(filename, ios::binary);
+        if(!fp.is_open())
+        {
+            cout << "ERROR InputReplay.Load: Couldn't open " << filename << "\n";
+            return false;
+        }
+
+        char magic[4] = {};
+        uint32_t version = 0;
+        uint8_t mode = 0;
+        fp.read(magic, 4);
+        fp.read((char *)&version, sizeof(version));
+        fp.read((char *)&seed, sizeof(seed));
+        fp.read((char *)&mode, sizeof(mode));
+        if(!fp || memcmp(magic, REPLAY_MAGIC, 4) || version != REPLAY_VERSION)
+        {
+            cout << "ERROR InputReplay.Load: " << filename << " isn't a version "
+                 << REPLAY_VERSION << " replay.\n";
+            return false;
+        }
+        ai_mode = (AIMode)mode;
+
+        runs.clear();
+        ticks = 0;
+        int buttons;
+        while((buttons = fp.get()) != EOF)
+        {
+            uint32_t count = 0;
+            int shift = 0;
+            int byte;
+            do
+            {
+                byte = fp.get();
+                if(byte == EOF || shift > 28)
+                {
+                    cout << "ERROR InputReplay.Load: " << filename << " is cut short.\n";
+                    return false;
+                }
+                count |= (uint32_t)(byte & 0x7f) << shift;
+                shift += 7;
+            } while(byte & 0x80);
+
+            runs.push_back({(uint8_t)buttons, count});
+            ticks += count;
+        }
+
+        next_run = 0;
+        left = 0;
+        playing = true;
+        return true;
+    }
+
+    // Stands in for HandleEvents(), once a tick. Returns false once the
+    // replay runs out.
+    bool
+    Feed(InputState *input)
+    {
+        while(!left)
+        {
+            if(next_run >= runs.size())
+            {
+                playing = false;
+                return false;
+            }
+            left = runs[next_run++].second;
+        }
+
+        UnpackInput(runs[next_run - 1].first, input);
+        --left;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,315 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Rollout
+
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include <atomic>
+#include <chrono>
+
+// ============================ Monte Carlo Planning ===========================
+// PredictCombat only knows the worst case, but every swing is a d100 roll.
+// For each candidate action, this plays the rest of the enemy phase out over
+// and over with random rolls, and keeps the action with the best average.
+//
+// The planner copies everything it needs out of the board up front, so the
+// workers never touch live units. It is started when a unit is selected and
+// collected when it acts, AI_ACTION_SPEED frames later, so drawing never stalls.
+// It's given no more time than that window, which shrinks as the phase is
+// sped up, and collecting it calls the search off wherever it's gotten to.
+//
+// NOTE: Follow-up attacks are found on the board as it stands before the
+// acting unit moves. Good enough to judge who is likely to be finished off.
+
+// An attack that one of the remaining units could make this phase.
+struct RolloutOption
+{
+    int attacker;
+    int target;
+    Outcome outcome;
+};
+
+// One thing the acting unit could do, and how it has fared so far.
+struct RolloutCandidate
+{
+    position pos;
+    Unit *target;
+    int target_index;
+    Outcome outcome;
+
+    double total;
+    int count;
+
+    double
+    Mean() const
+    {
+        return count ? total / count : -1e9;
+    }
+};
+
+struct RolloutPlanner
+{
+    // Snapshot of the board
+    vector<int> health = {};
+    vector<bool> is_ally = {};
+    vector<bool> is_leader = {};
+    int actor = -1;
+    vector<RolloutCandidate> candidates = {};
+    vector<vector<RolloutOption>> followers = {};
+
+    bool active = false;
+    double turn_budget_ms = ROLLOUT_TURN_BUDGET_MS;
+    int rollouts = 0;
+
+    WaitGroup running;
+    atomic<bool> stopping = {false}; // Workers wrap up once it's set.
+    mutex merge_lock;
+
+    ~RolloutPlanner()
+    {
+        stopping.store(true);
+        running.Wait();
+    }
+
+    // Called at the start of every AI phase.
+    void
+    ResetBudget()
+    {
+        stopping.store(true);
+        running.Wait();
+        active = false;
+        turn_budget_ms = ROLLOUT_TURN_BUDGET_MS;
+    }
+
+    // Snapshots the board and sets the workers loose on it, for no longer
+    // than window_ms. Expects map.accessible to have been filled in for the
+    // unit. The greedy action is always one of the candidates.
+    void
+    Begin(const Unit &unit, const Tilemap &map, const pair<position, Unit *> &greedy,
+          double window_ms)
+    {
+        stopping.store(true);
+        running.Wait();
+        active = false;
+        rollouts = 0;
+        actor = -1;
+        health.clear();
+        is_ally.clear();
+        is_leader.clear();
+        candidates.clear();
+        followers.clear();
+
+        // Index every unit on the board.
+        vector<Unit *> board = {};
+        for(int col = 0; col < map.width; ++col)
+        {
+            for(int row = 0; row < map.height; ++row)
+            {
+                Unit *occupant = map.tiles[col][row].occupant;
+                if(!occupant)
+                    continue;
+
+                if(occupant == &unit)
+                    actor = (int)board.size();
+                board.push_back(occupant);
+                health.push_back(occupant->health);
+                is_ally.push_back(occupant->is_ally);
+                is_leader.push_back(occupant->ID() == LEADER_ID);
+            }
+        }
+        SDL_assert(actor >= 0);
+
+        // What the acting unit could do.
+        candidates.push_back(MakeCandidate(unit, map, board, greedy));
+        for(const pair<position, Unit *> &poss : FindAttackingSquares(map, unit, map.accessible))
+        {
+            bool seen = false;
+            for(const RolloutCandidate &c : candidates)
+                if(c.pos == poss.first && c.target == poss.second)
+                    seen = true;
+            if(!seen)
+                candidates.push_back(MakeCandidate(unit, map, board, poss));
+        }
+
+        // Nothing to weigh up.
+        if(candidates.size() < 2)
+            return;
+
+        // What everyone else on our side could do after.
+        for(int i = 0; i < board.size(); ++i)
+        {
+            const Unit &other = *board[i];
+            if(i == actor || other.is_ally != unit.is_ally ||
+               other.is_exhausted || !other.Armed())
+                continue;
+
+            vector<position> accessible =
+                CachedAccessibleAndAttackableFrom(map, other.pos, other.movement,
+                                            other.MinRange(), other.MaxRange(),
+                                            other.is_ally).first;
+            vector<RolloutOption> options = {};
+            for(const pair<position, Unit *> &poss : FindAttackingSquares(map, other, accessible))
+            {
+                RolloutOption option = {i, IndexOf(board, poss.second),
+                                        Predict(other, *poss.second, map, poss.first)};
+                options.push_back(option);
+            }
+            if(!options.empty())
+                followers.push_back(options);
+        }
+
+        // Carve this unit's slice out of the phase's budget.
+        int remaining = 1;
+        for(Unit *u : board)
+            if(u != &unit && u->is_ally == unit.is_ally && !u->is_exhausted)
+                ++remaining;
+        double budget_ms = min({turn_budget_ms / remaining, (double)ROLLOUT_UNIT_BUDGET_MS, window_ms});
+        budget_ms = max(budget_ms, 1.0);
+        turn_budget_ms = max(turn_budget_ms - budget_ms, 0.0);
+
+        chrono::steady_clock::time_point deadline =
+            chrono::steady_clock::now() + chrono::microseconds((int)(budget_ms * 1000));
+
+        uint64_t seed = GlobalRng[RNG_AI].Next();
+        int workers = max(GlobalJobs.Size(), 1);
+        active = true;
+        stopping.store(false);
+        running.Add(workers);
+        for(int w = 0; w < workers; ++w)
+        {
+            GlobalJobs.Submit([this, deadline, seed, w]()
+                {
+                    Work(deadline, seed + w);
+                    running.Done();
+                });
+        }
+    }
+
+    // Calls the search off, then returns the best action found.
+    pair<position, Unit *>
+    Finish()
+    {
+        stopping.store(true);
+        running.Wait();
+        active = false;
+
+        int best = 0;
+        for(int i = 1; i < candidates.size(); ++i)
+            if(candidates[i].Mean() > candidates[best].Mean())
+                best = i;
+
+        return {candidates[best].pos, candidates[best].target};
+    }
+
+private:
+    static int
+    IndexOf(const vector<Unit *> &board, const Unit *unit)
+    {
+        for(int i = 0; i < board.size(); ++i)
+            if(board[i] == unit)
+                return i;
+        return -1;
+    }
+
+    static Outcome
+    Predict(const Unit &unit, const Unit &target, const Tilemap &map, const position &from)
+    {
+        return PredictCombat(unit, target,
+                             ManhattanDistance(from, target.pos),
+                             map.tiles[from.col][from.row].avoid,
+                             map.tiles[target.pos.col][target.pos.row].avoid,
+                             map.tiles[from.col][from.row].defense,
+                             map.tiles[target.pos.col][target.pos.row].defense);
+    }
+
+    static RolloutCandidate
+    MakeCandidate(const Unit &unit, const Tilemap &map, const vector<Unit *> &board,
+                  const pair<position, Unit *> &action)
+    {
+        RolloutCandidate candidate = {action.first, action.second, -1, {}, 0.0, 0};
+        if(action.second)
+        {
+            candidate.target_index = IndexOf(board, action.second);
+            candidate.outcome = Predict(unit, *action.second, map, action.first);
+        }
+        return candidate;
+    }
+
+    // Plays one candidate out to the end of the phase and scores the result
+    // from the acting unit's side.
+    double
+    Rollout(const RolloutCandidate &candidate, vector<int> *sim, Rng *rng) const
+    {
+        *sim = health;
+        auto roll = [rng](RngStream stream) { return rng->D100(); };
+
+        if(candidate.target)
+            SimulateFight(candidate.outcome, &(*sim)[actor], &(*sim)[candidate.target_index], roll);
+
+        for(const vector<RolloutOption> &options : followers)
+        {
+            if((*sim)[options[0].attacker] <= 0)
+                continue;
+
+            // Same rule of thumb as PursueBehavior: leave the target lowest.
+            const RolloutOption *pick = nullptr;
+            int lowest = 999;
+            for(const RolloutOption &option : options)
+            {
+                int target_health = (*sim)[option.target];
+                if(target_health <= 0)
+                    continue;
+                int left = max(target_health - option.outcome.one_damage * (1 + option.outcome.one_doubles), 0);
+                if(left < lowest)
+                {
+                    lowest = left;
+                    pick = &option;
+                }
+            }
+            if(pick)
+                SimulateFight(pick->outcome, &(*sim)[pick->attacker], &(*sim)[pick->target], roll);
+        }
+
+        double score = 0.0;
+        bool ours = is_ally[actor];
+        for(int i = 0; i < health.size(); ++i)
+        {
+            int lost = health[i] - (*sim)[i];
+            double value = lost;
+            if(health[i] > 0 && (*sim)[i] <= 0)
+                value += is_leader[i] ? ROLLOUT_LEADER_BONUS : ROLLOUT_KILL_BONUS;
+            score += (is_ally[i] == ours) ? -value : value;
+        }
+        return score;
+    }
+
+    // Runs on a worker. Round-robins the candidates until the deadline, or
+    // until it's called off. Every candidate gets at least one playout.
+    void
+    Work(chrono::steady_clock::time_point deadline, uint64_t seed)
+    {
+        Rng rng(seed);
+        vector<int> sim = health;
+        vector<double> totals(candidates.size(), 0.0);
+        int passes = 0;
+
+        do
+        {
+            for(int i = 0; i < candidates.size(); ++i)
+                totals[i] += Rollout(candidates[i], &sim, &rng);
+            ++passes;
+        }
+        while(!stopping.load() && chrono::steady_clock::now() < deadline);
+
+        lock_guard<mutex> guard(merge_lock);
+        for(int i = 0; i < candidates.size(); ++i)
+        {
+            candidates[i].total += totals[i];
+            candidates[i].count += passes;
+        }
+        rollouts += passes * (int)candidates.size();
+    }
+};
+
+#endif
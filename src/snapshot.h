@@ -0,0 +1,511 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Snapshot
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <fstream>
+
+// ================================= Snapshots =================================
+// The whole state of a battle, packed into bytes: the tiles, everyone on them
+// and what they're carrying, how far each conversation got, whose turn it is,
+// and the rolls to come. Restoring one puts the battle back exactly, without
+// going back to the level file.
+//
+// Cheap enough to take on a whim. Quicksaves, the autosave every player turn,
+// and anything that wants to try a line of play and take it back.
+//
+// File | "EMSS", version (u32), body size (u32), then the body. Every field is
+//        written as it sits in memory. See SnapshotBattle() for the order.
+//
+// NOTE: Restore between actions. Whatever's mid-flight (a fight, a queued AI
+// move, the cursor's selection) still points at the units it was given.
+
+#define SNAPSHOT_MAGIC "EMSS"
+#define SNAPSHOT_VERSION 2 // 2: Units keep their spawn.
+#define SNAPSHOT_HEADER_SIZE 12
+
+struct Snapshot
+{
+    vector<uint8_t> bytes = {};
+};
+
+struct SnapshotWriter
+{
+    vector<uint8_t> *bytes;
+
+    template <typename T>
+    void
+    Field(const T &value)
+    {
+        const uint8_t *start = (const uint8_t *)&value;
+        bytes->insert(bytes->end(), start, start + sizeof(T));
+    }
+
+    void
+    Field(const string &value)
+    {
+        Field((uint32_t)value.size());
+        bytes->insert(bytes->end(), value.begin(), value.end());
+    }
+};
+
+struct SnapshotReader
+{
+    const vector<uint8_t> *bytes;
+    size_t at = 0;
+    bool ok = true; // Goes false for good once a read runs off the end.
+
+    template <typename T>
+    void
+    Field(T &value)
+    {
+        if(!ok || at + sizeof(T) > bytes->size())
+        {
+            ok = false;
+            return;
+        }
+        memcpy(&value, bytes->data() + at, sizeof(T));
+        at += sizeof(T);
+    }
+
+    void
+    Field(string &value)
+    {
+        uint32_t size = 0;
+        Field(size);
+        if(!ok || at + size > bytes->size())
+        {
+            ok = false;
+            return;
+        }
+        value.assign((const char *)bytes->data() + at, size);
+        at += size;
+    }
+};
+
+// Items only keep their type and what's left of them. The rest comes from
+// GetItem().
+template <typename Archive>
+void
+SnapshotItem(Archive &archive, Item *&item)
+{
+    ItemType type = item ? item->type : ITEM_NONE;
+    int uses = (item && item->consumable) ? item->consumable->uses : -1;
+    archive.Field(type);
+    archive.Field(uses);
+
+    if(!item || item->type != type)
+    {
+        delete item;
+        item = GetItem(type);
+    }
+    if(item && item->consumable)
+        item->consumable->uses = uses;
+}
+
+template <typename Archive>
+void
+SnapshotBuff(Archive &archive, Buff *&buff)
+{
+    bool has_buff = buff;
+    Buff saved = buff ? *buff : Buff(STAT_NONE, 0, 0);
+    archive.Field(has_buff);
+    archive.Field(saved.stat);
+    archive.Field(saved.amount);
+    archive.Field(saved.turns_remaining);
+
+    if(!has_buff)
+    {
+        delete buff;
+        buff = nullptr;
+    }
+    else if(buff)
+        *buff = saved;
+    else
+        buff = new Buff(saved);
+}
+
+// Everything about a unit that can change over a campaign. Its name, and so
+// its textures, are written by the caller.
+template <typename Archive>
+void
+SnapshotUnit(Archive &archive, Unit &unit)
+{
+    archive.Field(unit.is_ally);
+    archive.Field(unit.movement);
+    archive.Field(unit.health);
+    archive.Field(unit.max_health);
+    archive.Field(unit.strength);
+    archive.Field(unit.magic);
+    archive.Field(unit.skill);
+    archive.Field(unit.speed);
+    archive.Field(unit.luck);
+    archive.Field(unit.defense);
+    archive.Field(unit.resistance);
+    archive.Field(unit.level);
+    archive.Field(unit.ability);
+    archive.Field(unit.growths);
+    archive.Field(unit.experience);
+    archive.Field(unit.turns_active);
+    archive.Field(unit.xp_value);
+    archive.Field(unit.ai_behavior);
+    archive.Field(unit.pos);
+    archive.Field(unit.is_exhausted);
+    archive.Field(unit.should_die);
+    archive.Field(unit.is_boss);
+    archive.Field(unit.spawn);
+
+    SnapshotItem(archive, unit.primary_item);
+    SnapshotItem(archive, unit.secondary_item);
+    SnapshotBuff(archive, unit.buff);
+}
+
+template <typename Archive>
+void
+SnapshotConversation(Archive &archive, Conversation &conversation)
+{
+    archive.Field(conversation.active.first);
+    archive.Field(conversation.active.second);
+    archive.Field(conversation.expressions.first);
+    archive.Field(conversation.expressions.second);
+    archive.Field(conversation.current);
+    archive.Field(conversation.done);
+}
+
+// Calls the given function on every conversation in the level, in a fixed
+// order, with its place in that order.
+template <typename Visit>
+void
+ForEachConversation(ConversationList &conversations, Visit visit)
+{
+    int index = 0;
+    visit(conversations.prelude, index++);
+    for(Conversation &conversation : conversations.list)
+        visit(conversation, index++);
+    for(Conversation &conversation : conversations.mid_battle)
+        visit(conversation, index++);
+    for(Conversation &conversation : conversations.villages)
+        visit(conversation, index++);
+}
+
+// Whatever isn't tied to a unit. Written the same way both ways.
+template <typename Archive>
+void
+SnapshotBattle(Archive &archive, Level &level)
+{
+    archive.Field(level.objective);
+    archive.Field(level.seed);
+
+    archive.Field(GlobalInterfaceState);
+    archive.Field(GlobalAIState);
+    archive.Field(GlobalPlayerTurn);
+    archive.Field(GlobalTurnStart);
+    archive.Field(GlobalNextLevel);
+    archive.Field(GlobalRng);
+
+    archive.Field(level.conversations.index);
+    int current = -1;
+    ForEachConversation(level.conversations, [&](Conversation &conversation, int index)
+        {
+            SnapshotConversation(archive, conversation);
+            if(level.conversations.current == &conversation)
+                current = index;
+        });
+    archive.Field(current);
+    level.conversations.current = nullptr;
+    ForEachConversation(level.conversations, [&](Conversation &conversation, int index)
+        {
+            if(index == current)
+                level.conversations.current = &conversation;
+        });
+}
+
+// Writes the battle out, over whatever the snapshot held before.
+void
+TakeSnapshot(Level &level, Snapshot *snapshot)
+{
+    vector<uint8_t> &bytes = snapshot->bytes;
+    bytes.clear();
+    bytes.reserve(SNAPSHOT_HEADER_SIZE + 64 * level.map.width * level.map.height +
+                  256 * level.combatants.size());
+
+    SnapshotWriter writer = {&bytes};
+    bytes.insert(bytes.end(), SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 4);
+    writer.Field((uint32_t)SNAPSHOT_VERSION);
+    writer.Field((uint32_t)0); // Body size, filled in below.
+
+    writer.Field(level.name);
+    int conversations = 0;
+    ForEachConversation(level.conversations, [&](Conversation &, int) { ++conversations; });
+    writer.Field(conversations);
+
+    writer.Field(level.map.width);
+    writer.Field(level.map.height);
+    for(int col = 0; col < level.map.width; ++col)
+    {
+        for(int row = 0; row < level.map.height; ++row)
+        {
+            const Tile &tile = level.map.tiles[col][row];
+            writer.Field(tile.type);
+            writer.Field(tile.penalty);
+            writer.Field(tile.avoid);
+            writer.Field(tile.defense);
+            writer.Field(tile.atlas_index);
+        }
+    }
+
+    writer.Field((int)level.combatants.size());
+    for(const shared_ptr<Unit> &unit : level.combatants)
+    {
+        writer.Field(unit->name);
+        SnapshotUnit(writer, *unit);
+    }
+
+    SnapshotBattle(writer, level);
+
+    uint32_t body = (uint32_t)(bytes.size() - SNAPSHOT_HEADER_SIZE);
+    memcpy(bytes.data() + 8, &body, sizeof(body));
+}
+
+// A fresh copy of the named unit, from the party if they're in it.
+shared_ptr<Unit>
+CopyUnitNamed(const string &name, const vector<shared_ptr<Unit>> &units,
+              const vector<shared_ptr<Unit>> &party)
+{
+    size_t id = hash<string>{}(name);
+    for(const shared_ptr<Unit> &unit : party)
+        if(unit->ID() == id)
+            return make_shared<Unit>(*unit);
+    for(const shared_ptr<Unit> &unit : units)
+        if(unit->ID() == id)
+            return make_shared<Unit>(*unit);
+    return nullptr;
+}
+
+// Reads the snapshot's body onto the level, from the map on. With dry_run,
+// units are read onto copies, so nothing outside the level is touched. The
+// globals SnapshotBattle() reads are the caller's to put back.
+//
+// Returns false if anything doesn't read, or doesn't fit.
+bool
+ReadSnapshotBody(SnapshotReader reader, Level *level,
+                 const vector<shared_ptr<Unit>> &units,
+                 const vector<shared_ptr<Unit>> &party,
+                 bool dry_run)
+{
+    Tilemap &map = level->map;
+    int width = 0;
+    int height = 0;
+    reader.Field(width);
+    reader.Field(height);
+    // NOTE: Every tile takes up more than a byte.
+    if(!reader.ok || width <= 0 || height <= 0 ||
+       (size_t)width * height > reader.bytes->size() - reader.at)
+    {
+        cout << "ERROR RestoreSnapshot: Bad map size " << width << "x" << height << ".\n";
+        return false;
+    }
+    map.width = width;
+    map.height = height;
+    map.tiles.assign(map.width, vector<Tile>(map.height));
+    for(int col = 0; col < map.width; ++col)
+    {
+        for(int row = 0; row < map.height; ++row)
+        {
+            Tile &tile = map.tiles[col][row];
+            reader.Field(tile.type);
+            reader.Field(tile.penalty);
+            reader.Field(tile.avoid);
+            reader.Field(tile.defense);
+            reader.Field(tile.atlas_index);
+        }
+    }
+    map.RehashTerrain();
+    map.accessible = {};
+    map.attackable = {};
+    map.ability = {};
+    map.range = {};
+    map.adjacent = {};
+    map.vis_range = {};
+    map.double_range = {};
+
+    int count = 0;
+    reader.Field(count);
+    vector<shared_ptr<Unit>> unclaimed = level->combatants;
+    vector<shared_ptr<Unit>> combatants = {};
+    for(int i = 0; i < count && reader.ok; ++i)
+    {
+        string unit_name;
+        reader.Field(unit_name);
+
+        shared_ptr<Unit> unit = nullptr;
+        size_t id = hash<string>{}(unit_name);
+        for(shared_ptr<Unit> &candidate : unclaimed)
+        {
+            if(candidate && candidate->ID() == id)
+            {
+                unit = candidate;
+                candidate = nullptr;
+                break;
+            }
+        }
+        if(!unit)
+            unit = CopyUnitNamed(unit_name, units, party);
+        if(!unit)
+        {
+            cout << "ERROR RestoreSnapshot: No unit named " << unit_name << ".\n";
+            return false;
+        }
+        if(dry_run)
+            unit = make_shared<Unit>(*unit);
+
+        SnapshotUnit(reader, *unit);
+        if(!reader.ok)
+            break;
+        if(unit->pos.col < 0 || unit->pos.col >= map.width ||
+           unit->pos.row < 0 || unit->pos.row >= map.height)
+        {
+            cout << "ERROR RestoreSnapshot: " << unit_name << " is off the map.\n";
+            return false;
+        }
+        unit->animation_offset = {0, 0};
+        unit->last_offset = {0, 0};
+        unit->Rehash();
+        unit->Derive();
+        combatants.push_back(unit);
+        map.tiles[unit->pos.col][unit->pos.row].occupant = unit.get();
+    }
+    level->combatants = combatants;
+    level->spawned = 0;
+    for(const shared_ptr<Unit> &unit : combatants)
+        level->spawned = max(level->spawned, unit->spawn + 1);
+
+    SnapshotBattle(reader, *level);
+    if(!reader.ok)
+    {
+        cout << "ERROR RestoreSnapshot: Snapshot is cut short.\n";
+        return false;
+    }
+    return true;
+}
+
+// Puts the battle back the way the snapshot has it. Units already on the board
+// are reused, by name. Anyone missing is copied from the party or the roster,
+// and if the snapshot is of another level, that level is loaded first.
+//
+// The whole snapshot is read once onto copies before anything's changed, so
+// one that doesn't read leaves the battle as it was.
+//
+// Returns false if the snapshot can't be read, or no longer fits the level.
+bool
+RestoreSnapshot(const Snapshot &snapshot, Level *level,
+                const vector<shared_ptr<Unit>> &units,
+                const vector<shared_ptr<Unit>> &party)
+{
+    const vector<uint8_t> &bytes = snapshot.bytes;
+    SnapshotReader reader = {&bytes};
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    uint32_t body = 0;
+    reader.Field(magic);
+    reader.Field(version);
+    reader.Field(body);
+    if(!reader.ok || memcmp(magic, SNAPSHOT_MAGIC, 4) || version != SNAPSHOT_VERSION)
+    {
+        cout << "ERROR RestoreSnapshot: Not a version " << SNAPSHOT_VERSION << " snapshot.\n";
+        return false;
+    }
+    if(body != bytes.size() - SNAPSHOT_HEADER_SIZE)
+    {
+        cout << "ERROR RestoreSnapshot: Snapshot is cut short.\n";
+        return false;
+    }
+
+    string name;
+    int conversations = 0;
+    reader.Field(name);
+    reader.Field(conversations);
+    if(!reader.ok)
+    {
+        cout << "ERROR RestoreSnapshot: Snapshot is cut short.\n";
+        return false;
+    }
+
+    Level loaded;
+    Level *target = level;
+    if(name != level->name)
+    {
+        loaded = LoadLevel(name, units, party);
+        target = &loaded;
+    }
+
+    int level_conversations = 0;
+    ForEachConversation(target->conversations, [&](Conversation &, int) { ++level_conversations; });
+    if(conversations != level_conversations)
+    {
+        cout << "ERROR RestoreSnapshot: " << name << " has changed since the snapshot.\n";
+        return false;
+    }
+
+    // The dry run. SnapshotBattle() reads these straight in.
+    {
+        Level scratch = *target;
+        InterfaceState interface_state = GlobalInterfaceState;
+        AIState ai_state = GlobalAIState;
+        bool player_turn = GlobalPlayerTurn;
+        bool turn_start = GlobalTurnStart;
+        bool next_level = GlobalNextLevel;
+        RngStreams rng = GlobalRng;
+
+        bool ok = ReadSnapshotBody(reader, &scratch, units, party, true);
+
+        GlobalInterfaceState = interface_state;
+        GlobalAIState = ai_state;
+        GlobalPlayerTurn = player_turn;
+        GlobalTurnStart = turn_start;
+        GlobalNextLevel = next_level;
+        GlobalRng = rng;
+        if(!ok)
+            return false;
+    }
+
+    if(target != level)
+        *level = loaded;
+    bool ok = ReadSnapshotBody(reader, level, units, party, false);
+    SDL_assert(ok);
+
+    if(level->conversations.current)
+        level->conversations.current->ReloadTextures();
+    return true;
+}
+
+bool
+SaveSnapshot(const string &filename, const Snapshot &snapshot)
+{
+    ofstream fp(filename, ios::binary);
+    if(!fp.is_open())
+    {
+        cout << "WARN SaveSnapshot: Couldn't open " << filename << "\n";
+        return false;
+    }
+    fp.write((const char *)snapshot.bytes.data(), snapshot.bytes.size());
+    return true;
+}
+
+bool
+LoadSnapshot(const string &filename, Snapshot *snapshot)
+{
+    ifstream fp(filename, ios::binary);
+    if(!fp.is_open())
+    {
+        cout << "ERROR LoadSnapshot: Couldn't open " << filename << "\n";
+        return false;
+    }
+    snapshot->bytes.assign(istreambuf_iterator<char>(fp), istreambuf_iterator<char>());
+    return true;
+}
+
+#endif
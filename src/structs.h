@@ -29,6 +29,7 @@ struct Texture
     string dir;
     int width;
     int height;
+    shared_ptr<TextureResource> resource = nullptr; // Keeps sdl_texture alive.
 
     Texture(SDL_Texture *sdl_texture_in, string dir_in, string filename_in, int width_in, int height_in)
     {
@@ -39,6 +40,12 @@ struct Texture
         this->filename = filename_in;
     }
 
+    Texture(shared_ptr<TextureResource> resource_in, string dir_in, string filename_in, int width_in, int height_in)
+    : Texture(resource_in->sdl_texture, dir_in, filename_in, width_in, height_in)
+    {
+        this->resource = resource_in;
+    }
+
     Texture() = default;
 };
 
@@ -56,6 +63,7 @@ enum SheetTrack
 struct Spritesheet
 {
     Texture texture;
+    SDL_Rect region = {}; // Where on the texture it is. See atlas.h.
     int size    = SPRITE_SIZE;
     int tracks  = 0;
     int frames  = 0;
@@ -64,13 +72,25 @@ struct Spritesheet
     int speed   = 1; // inverse. 1 is faster than 10.
     int counter = 0;
 
-    Spritesheet(Texture texture_in, int size_in, int speed_in)
+    Spritesheet(Texture texture_in, SDL_Rect region_in, int size_in, int speed_in)
     : texture(texture_in),
+      region(region_in),
       size(size_in),
       speed(speed_in)
     {
-        this->tracks = texture_in.height / size_in;
-        this->frames = texture_in.width / size_in;
+        this->tracks = region_in.h / size_in;
+        this->frames = region_in.w / size_in;
+    }
+
+    Spritesheet(Texture texture_in, int size_in, int speed_in)
+    : Spritesheet(texture_in, {0, 0, texture_in.width, texture_in.height}, size_in, speed_in)
+    {}
+
+    // The part of the texture showing the current frame.
+    SDL_Rect
+    Frame() const
+    {
+        return {region.x + frame * size, region.y + track * size, size, size};
     }
 
     // called each frame
@@ -168,6 +188,54 @@ enum Expression
     EXPR_WINCE,
 };
 
+// ================================== Zobrist ==================================
+// Each unit carries a key summing up everything about it that the AI reads.
+// Mutators swap the old feature's key out and the new one in, so the key stays
+// current without rescanning the unit. See Tilemap::Hash() for the board.
+//
+// Keys go by the unit's spawn, not its name. A level can have dozens of units
+// with the same name, and they'd all share keys otherwise.
+enum ZobristFeature
+{
+    ZOBRIST_POSITION,
+    ZOBRIST_HEALTH,
+    ZOBRIST_EXHAUSTED,
+    ZOBRIST_BUFF,
+    ZOBRIST_LOADOUT,
+    ZOBRIST_FEATURES,
+};
+
+// The pseudo-random key for a unit having a given feature at a given value.
+uint64_t
+ZobristKey(uint64_t id, ZobristFeature feature, uint64_t value)
+{
+    return Mix64(id ^ Mix64(((uint64_t)feature << 56) ^ value));
+}
+
+// =============================== Derived Stats ===============================
+// The numbers combat is worked out from. They only move when items are
+// switched or dropped, a buff comes or goes, or the unit levels up, so they're
+// worked out then, in Unit::Derive(), instead of on every read.
+struct DerivedStats
+{
+    int hit = 0;
+    int avoid = 0;        // From the unbuffed attack speed.
+    int crit = 0;
+    int attack = 0;
+    int attack_speed = 0;
+    int min_range = 0;
+    int max_range = 0;
+
+    // With the unit's buff folded in.
+    int buffed_attack = 0;
+    int buffed_defense = 0;
+    int buffed_speed = 0;
+};
+
+// CIRCULAR | See journal.h. Called before a unit changes, so it can be undone.
+struct Unit;
+void JournalUnit(Unit *unit);
+
 struct Unit
 {
     string name;
@@ -190,8 +258,8 @@ struct Unit
     Growths growths = {};
     int experience = 0;
 
-    Item *primary_item;
-    Item *secondary_item;
+    Item *primary_item = nullptr;
+    Item *secondary_item = nullptr;
 
     int turns_active = -1;
     int xp_value = 0;
@@ -200,10 +268,20 @@ struct Unit
     bool is_exhausted = false;
     bool should_die = false;
     position animation_offset = {0, 0};
+    position last_offset = {0, 0}; // As of the tick before. For drawing in between.
     bool is_boss = false;
+    int spawn = 0; // Where in its level's spawn order this unit was put down.
 
     Buff *buff = nullptr;
 
+    // NOTE: Write position, health, exhaustion and buffs through the
+    // methods below, or this goes stale.
+    uint64_t zobrist = 0;
+
+    // NOTE: Same goes for items, buffs and stats. Call Derive() after writing
+    // them any other way.
+    DerivedStats derived = {};
+
     Spritesheet sheet;
     Texture neutral;
     Texture happy;
@@ -218,7 +296,7 @@ struct Unit
     }
 
     size_t
-    ID()
+    ID() const
     {
         return hash<string>{}(name);
     }
@@ -295,6 +373,9 @@ struct Unit
 
       primary_item = GetItem(primary_item_type_in);
       secondary_item = GetItem(secondary_item_type_in);
+
+      Rehash();
+      Derive();
     }
 
     Unit(const Unit &other)
@@ -314,6 +395,7 @@ struct Unit
       ability(other.ability),
       ai_behavior(other.ai_behavior),
       xp_value(other.xp_value),
+      spawn(other.spawn),
       sheet(other.sheet),
       neutral(other.neutral),
       happy(other.happy),
@@ -333,15 +415,105 @@ struct Unit
           primary_item = new Item(*other.primary_item);
       if(other.secondary_item)
           secondary_item = new Item(*other.secondary_item);
+
+      Rehash();
+      Derive();
+    }
+
+    // ============================= Zobrist ===================================
+    // The current value of one hashed feature.
+    uint64_t
+    FeatureValue(ZobristFeature feature) const
+    {
+        switch(feature)
+        {
+            case ZOBRIST_POSITION:  return ((uint64_t)(uint32_t)pos.col << 32) | (uint32_t)pos.row;
+            case ZOBRIST_HEALTH:    return (uint64_t)health;
+            case ZOBRIST_EXHAUSTED: return is_exhausted;
+            case ZOBRIST_BUFF:
+            {
+                if(!buff)
+                    return 0;
+                return ((uint64_t)buff->stat << 48) ^ ((uint64_t)(uint16_t)buff->amount << 32) ^
+                       ((uint64_t)(uint32_t)buff->turns_remaining + 1);
+            }
+            case ZOBRIST_LOADOUT:
+            {
+                uint64_t result = is_ally;
+                for(int x : {level, max_health, movement, strength, magic, skill,
+                             speed, luck, defense, resistance})
+                    result = Mix64(result ^ (uint32_t)x);
+                result = Mix64(result ^ (primary_item ? primary_item->type + 1 : 0));
+                result = Mix64(result ^ (secondary_item ? secondary_item->type + 1 : 0));
+                return result;
+            }
+            default: SDL_assert(!"ERROR Unhandled enum in Unit.FeatureValue()"); return 0;
+        }
+    }
+
+    // What this unit's keys are seeded from. Unique among a level's units.
+    uint64_t
+    ZobristID() const
+    {
+        return Mix64((uint64_t)spawn + 1);
+    }
+
+    // Recomputes the whole key. Only needed when a unit is made, or edited
+    // other than through the methods below.
+    void
+    Rehash()
+    {
+        zobrist = 0;
+        for(int feature = 0; feature < ZOBRIST_FEATURES; ++feature)
+            zobrist ^= ZobristKey(ZobristID(), (ZobristFeature)feature,
+                                  FeatureValue((ZobristFeature)feature));
+    }
+
+    // Swaps a feature's old key for its current one.
+    void
+    Rekey(ZobristFeature feature, uint64_t old_value)
+    {
+        zobrist ^= ZobristKey(ZobristID(), feature, old_value) ^
+                   ZobristKey(ZobristID(), feature, FeatureValue(feature));
+    }
+
+    // Puts the unit at the given place in its level's spawn order.
+    void
+    SetSpawn(int spawn_in)
+    {
+        spawn = spawn_in;
+        Rehash();
+    }
+
+    void
+    SetPosition(const position &pos_in)
+    {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_POSITION);
+        pos = pos_in;
+        Rekey(ZOBRIST_POSITION, old_value);
+    }
+
+    void
+    SetHealth(int health_in)
+    {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_HEALTH);
+        health = health_in;
+        Rekey(ZOBRIST_HEALTH, old_value);
     }
 
     // Switches the primary item with the secondary item
     void
     SwitchItems()
     {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_LOADOUT);
         Item *tmp = primary_item;
         primary_item = secondary_item;
         secondary_item = tmp;
+        Rekey(ZOBRIST_LOADOUT, old_value);
+        Derive();
     }
 
     // Uses the primary item
@@ -371,8 +543,12 @@ struct Unit
     void
     Discard()
     {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_LOADOUT);
         delete primary_item;
         primary_item = nullptr;
+        Rekey(ZOBRIST_LOADOUT, old_value);
+        Derive();
     }
 
     bool
@@ -402,16 +578,12 @@ struct Unit
     int
     MinRange() const
     {
-        if(primary_item && primary_item->weapon)
-            return primary_item->weapon->min_range;
-        return 0;
+        return derived.min_range;
     }
     int
     MaxRange() const
     {
-        if(primary_item && primary_item->weapon)
-            return primary_item->weapon->max_range;
-        return 0;
+        return derived.max_range;
     }
 
     int
@@ -448,43 +620,64 @@ struct Unit
     void
     Damage(int amount)
     {
-        health = clamp(health - amount, 0, max_health);
+        SetHealth(clamp(health - amount, 0, max_health));
     }
 
     // Heals a unit and resolves things involved with that process.
     void
     Heal(int amount)
     {
-        health = clamp(health + amount, 0, max_health);
+        SetHealth(clamp(health + amount, 0, max_health));
     }
 
     void
     Deactivate()
     {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_EXHAUSTED);
         is_exhausted = true;
+        Rekey(ZOBRIST_EXHAUSTED, old_value);
         sheet.ChangeTrack(TRACK_IDLE);
     }
     void
     Activate()
     {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_EXHAUSTED);
         is_exhausted = false;
+        Rekey(ZOBRIST_EXHAUSTED, old_value);
     }
     void
     ApplyBuff(Buff *buff_in)
     {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_BUFF);
         buff = buff_in;
+        Rekey(ZOBRIST_BUFF, old_value);
+        Derive();
+    }
+
+    void
+    ClearBuff()
+    {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_BUFF);
+        delete buff;
+        buff = nullptr;
+        Rekey(ZOBRIST_BUFF, old_value);
+        Derive();
     }
 
     // Called every turn. If buff is over, deletes the buff.
     void
     TickBuff()
     {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_BUFF);
         --(buff->turns_remaining);
+        Rekey(ZOBRIST_BUFF, old_value);
         if(buff->turns_remaining <= 0)
-        {
-            delete buff;
-            buff = nullptr;
-        }
+            ClearBuff();
     }
 
     int
@@ -497,7 +690,7 @@ struct Unit
             growth -= 100;
         }
 
-        if(d100() < growth)
+        if(d100(RNG_GROWTH) < growth)
         {
             result += 1;
         }
@@ -508,6 +701,8 @@ struct Unit
     void
     LevelUp()
     {
+        JournalUnit(this);
+        uint64_t old_value = FeatureValue(ZOBRIST_LOADOUT);
         level += 1;
         
         max_health += StatBoost(growths.health);
@@ -520,14 +715,17 @@ struct Unit
         resistance += StatBoost(growths.resistance);
 
         experience -= 100;
-        if(level == 10)
+        if(level == MAX_LEVEL)
             experience = 0;
+        Rekey(ZOBRIST_LOADOUT, old_value);
+        Derive();
     }
 
     void
     GrantExperience(int amount)
     {
-        if(level == 10)
+        JournalUnit(this);
+        if(level == MAX_LEVEL)
             return;
 
         experience += amount;
@@ -538,24 +736,19 @@ struct Unit
     int
     Hit() const
     {
-        if(!Armed())
-            return 0;
-        return primary_item->weapon->hit + 2 * skill;
+        return derived.hit;
     }
-    // COMMENT
 
     int
     Avoid() const
     {
-        return 2 * AttackSpeed();
+        return derived.avoid;
     }
 
     int
     Attack() const
     {
-        if(!Armed())
-            return 0;
-        return primary_item->weapon->might + strength;
+        return derived.attack;
     }
 
     bool
@@ -567,18 +760,42 @@ struct Unit
     int
     AttackSpeed() const
     {
-        if(Armed())
-        {
-            return speed - primary_item->weapon->weight; // TODO; + CON!!!
-        }
-        return speed;
+        return derived.attack_speed;
     }
 
     int
     Crit() const
     {
-        return skill * 2;
-        // TODO: Make this less for enemies.
+        return derived.crit;
+    }
+
+    int
+    BuffAmount(Stat stat) const
+    {
+        return (buff && buff->stat == stat) ? buff->amount : 0;
+    }
+
+    // Works the derived stats back out from the unit's stats, items and buff.
+    void
+    Derive()
+    {
+        derived = {};
+        derived.attack_speed = speed;
+        if(Armed())
+        {
+            const WeaponComponent *weapon = primary_item->weapon;
+            derived.hit = weapon->hit + 2 * skill;
+            derived.attack = weapon->might + strength;
+            derived.attack_speed = speed - weapon->weight; // TODO; + CON!!!
+            derived.min_range = weapon->min_range;
+            derived.max_range = weapon->max_range;
+        }
+        derived.avoid = 2 * derived.attack_speed;
+        derived.crit = skill * 2; // TODO: Make this less for enemies.
+
+        derived.buffed_attack = derived.attack + BuffAmount(STAT_ATTACK);
+        derived.buffed_defense = defense + BuffAmount(STAT_DEFENSE);
+        derived.buffed_speed = derived.attack_speed + BuffAmount(STAT_SPEED);
     }
 };
 
@@ -777,6 +994,31 @@ struct Tilemap
     Texture atlas;
     int atlas_tile_size = ATLAS_TILE_SIZE;
 
+    // Key for the terrain alone. Call RehashTerrain() after changing tiles.
+    uint64_t terrain_key = 0;
+
+    void
+    RehashTerrain()
+    {
+        terrain_key = 0;
+        for(int col = 0; col < width; ++col)
+            for(int row = 0; row < height; ++row)
+                terrain_key ^= Mix64(((uint64_t)col << 40) ^ ((uint64_t)row << 20) ^
+                                     (uint64_t)tiles[col][row].type);
+    }
+
+    // The whole board's key. The terrain plus every unit standing on it.
+    uint64_t
+    Hash() const
+    {
+        uint64_t result = terrain_key;
+        for(int col = 0; col < width; ++col)
+            for(int row = 0; row < height; ++row)
+                if(tiles[col][row].occupant)
+                    result ^= tiles[col][row].occupant->zobrist;
+        return result;
+    }
+
     position
     GetNextSpawnLocation()
     {
@@ -811,12 +1053,15 @@ struct Level
     Sound *song = nullptr;
     ConversationList conversations;
     string name = "";
+    uint64_t seed = 0; // What this battle's rolls came from.
+    int spawned = 0; // Units put down so far. The next one's spawn.
 
     // Puts a piece on the board
     void
     AddCombatant(shared_ptr<Unit> newcomer, const position &pos)
     {
-        newcomer->pos = pos;
+        newcomer->SetSpawn(spawned++);
+        newcomer->SetPosition(pos);
         combatants.push_back(newcomer);
         SDL_assert(!map.tiles[pos.col][pos.row].occupant);
         map.tiles[pos.col][pos.row].occupant = newcomer.get();
@@ -835,6 +1080,21 @@ struct Level
         return position(0, 0);
     }
 
+    // The start of a side's phase. Everyone can move again, and the other side
+    // counts another turn. Buffs run down as each round starts.
+    void
+    StartPhase(bool player_phase)
+    {
+        for(const shared_ptr<Unit> &unit : combatants)
+        {
+            if(unit->is_ally != player_phase)
+                ++unit->turns_active;
+            if(player_phase && unit->buff)
+                unit->TickBuff();
+            unit->Activate();
+        }
+    }
+
     bool
     IsBossDead()
     {
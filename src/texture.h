@@ -0,0 +1,307 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Texture
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <atomic>
+#include <unordered_map>
+
+// ============================== Texture Cache ================================
+// Every image is decoded and uploaded once, however many things show it. The
+// cache hands out shared handles keyed by path, and the texture is destroyed
+// when the last Texture holding it goes away. Text is uploaded fresh each
+// time, since it's rarely the same twice, but it's freed the same way.
+//
+// Keeps a rough count of the video memory in use, by category, for the
+// editor's Textures panel. See TextureViewer().
+//
+// Images can be asked for ahead of time with Request(), which decodes them on
+// GlobalJobs. Only the upload to the GPU is left for the main thread, and
+// whatever streams images in (see PortraitCache.Update()) keeps to
+// UPLOAD_BUDGET_MS of uploads a frame. Loading one that's still being decoded
+// waits for it, or decodes it right there if no worker's gotten to it yet.
+//
+// NOTE: Main thread only, like the renderer. Workers only ever see a
+// DecodeJob.
+
+enum TextureCategory
+{
+    TEXTURE_SPRITE,
+    TEXTURE_PORTRAIT,
+    TEXTURE_TILESET,
+    TEXTURE_TEXT,
+    TEXTURE_OTHER,
+    TEXTURE_CATEGORIES,
+};
+
+string
+GetTextureCategoryString(TextureCategory category)
+{
+    switch(category)
+    {
+        case TEXTURE_SPRITE:   return "sprite";
+        case TEXTURE_PORTRAIT: return "portrait";
+        case TEXTURE_TILESET:  return "tileset";
+        case TEXTURE_TEXT:     return "text";
+        case TEXTURE_OTHER:    return "other";
+        default: SDL_assert(!"ERROR Unhandled enum in GetTextureCategoryString"); return "";
+    }
+}
+
+TextureCategory
+GetTextureCategory(const string &path)
+{
+    if(path == SPRITES_PATH)
+        return TEXTURE_SPRITE;
+    if(path == FULLS_PATH || path == THUMBS_PATH)
+        return TEXTURE_PORTRAIT;
+    if(path == TILESETS_PATH)
+        return TEXTURE_TILESET;
+    return TEXTURE_OTHER;
+}
+
+// One texture on the GPU, for as long as anything holds on to it.
+struct TextureResource
+{
+    SDL_Texture *sdl_texture = nullptr;
+    string key = "";        // Path and filename. Empty for text.
+    TextureCategory category = TEXTURE_OTHER;
+    int width = 0;
+    int height = 0;
+    int bytes = 0;          // Estimated. Four a pixel.
+
+    ~TextureResource();
+};
+
+// An image being decoded into memory the GPU hasn't seen yet.
+struct DecodeJob
+{
+    string key = "";
+    atomic<bool> taken = {false};   // Someone's started decoding it.
+    atomic<bool> done = {false};
+    SDL_Surface *surface = nullptr; // Only to be read once done.
+
+    void
+    Decode()
+    {
+        surface = IMG_Load(key.c_str());
+        done.store(true);
+    }
+
+    ~DecodeJob()
+    {
+        if(surface)
+            SDL_FreeSurface(surface);
+    }
+};
+
+struct TextureCache
+{
+    unordered_map<string, weak_ptr<TextureResource>> resident = {};
+    unordered_map<string, shared_ptr<DecodeJob>> decoding = {};
+    int64_t bytes[TEXTURE_CATEGORIES] = {};
+    int count[TEXTURE_CATEGORIES] = {};
+    int hits = 0;
+    int misses = 0;
+    int requests = 0;   // Decodes started ahead of time.
+    double upload_ms = 0.0; // Spent uploading this frame.
+
+    // The texture loaded from key, if anything's still holding it.
+    shared_ptr<TextureResource>
+    Find(const string &key)
+    {
+        auto found = resident.find(key);
+        if(found == resident.end())
+        {
+            ++misses;
+            return nullptr;
+        }
+        shared_ptr<TextureResource> result = found->second.lock();
+        result ? ++hits : ++misses;
+        return result;
+    }
+
+    // Takes ownership of sdl_texture. Only image textures get a key.
+    shared_ptr<TextureResource>
+    Add(SDL_Texture *sdl_texture, const string &key, TextureCategory category,
+        int width, int height)
+    {
+        shared_ptr<TextureResource> result = make_shared<TextureResource>();
+        result->sdl_texture = sdl_texture;
+        result->key = key;
+        result->category = category;
+        result->width = width;
+        result->height = height;
+        result->bytes = width * height * 4;
+
+        bytes[category] += result->bytes;
+        ++count[category];
+        if(!key.empty())
+            resident[key] = result;
+        return result;
+    }
+
+    // Called as a texture's freed.
+    void
+    Forget(const TextureResource &resource)
+    {
+        bytes[resource.category] -= resource.bytes;
+        --count[resource.category];
+        if(!resource.key.empty())
+        {
+            auto found = resident.find(resource.key);
+            if(found != resident.end() && found->second.expired())
+                resident.erase(found);
+        }
+    }
+
+    // Starts decoding the image on a worker, unless it's loaded or on its way.
+    void
+    Request(const string &path, const string &filename)
+    {
+        if(HEADLESS)
+            return;
+        string key = path + filename;
+        if(decoding.count(key))
+            return;
+        auto found = resident.find(key);
+        if(found != resident.end() && !found->second.expired())
+            return;
+
+        shared_ptr<DecodeJob> job = make_shared<DecodeJob>();
+        job->key = key;
+        decoding[key] = job;
+        ++requests;
+        GlobalJobs.Submit([job]()
+            {
+                if(!job->taken.exchange(true))
+                    job->Decode();
+            });
+    }
+
+    // Whether a requested image is decoded, and only needs uploading.
+    bool
+    Decoded(const string &key) const
+    {
+        auto found = decoding.find(key);
+        return found != decoding.end() && found->second->done.load();
+    }
+
+    // No longer wanted. A worker that's started on it finishes, and the
+    // result's thrown away.
+    void
+    Cancel(const string &key)
+    {
+        auto found = decoding.find(key);
+        if(found == decoding.end())
+            return;
+        found->second->taken.store(true); // A job that hasn't started does nothing.
+        decoding.erase(found);
+    }
+
+    void
+    CancelAll()
+    {
+        for(auto &entry : decoding)
+            entry.second->taken.store(true);
+        decoding.clear();
+    }
+
+    // Whether any requested image is still being decoded.
+    bool
+    Pending() const
+    {
+        for(const auto &entry : decoding)
+            if(!entry.second->done.load())
+                return true;
+        return false;
+    }
+
+    // The image, decoded, for the caller to free. Null if it didn't load.
+    SDL_Surface *
+    TakeSurface(const string &path, const string &filename)
+    {
+        string key = path + filename;
+        shared_ptr<DecodeJob> job = nullptr;
+        auto found = decoding.find(key);
+        if(found != decoding.end())
+        {
+            job = found->second;
+            decoding.erase(found);
+        }
+        else
+        {
+            job = make_shared<DecodeJob>();
+            job->key = key;
+        }
+
+        // Still queued, or never asked for. Quicker to do it here than wait.
+        if(!job->taken.exchange(true))
+            job->Decode();
+        while(!job->done.load())
+            this_thread::yield();
+
+        SDL_Surface *result = job->surface;
+        job->surface = nullptr;
+        return result;
+    }
+
+    // The image, loaded. Decodes and uploads it now if it has to.
+    shared_ptr<TextureResource>
+    Load(const string &path, const string &filename)
+    {
+        string key = path + filename;
+        if(shared_ptr<TextureResource> cached = Find(key))
+            return cached;
+
+        SDL_Surface *surface = TakeSurface(path, filename);
+        SDL_assert(surface);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        int width = surface->w;
+        int height = surface->h;
+        SDL_Texture *texture = SDL_CreateTextureFromSurface(GlobalRenderer, surface);
+        SDL_assert(texture);
+        SDL_FreeSurface(surface);
+        upload_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        return Add(texture, key, GetTextureCategory(path), width, height);
+    }
+
+    // Called at the start of each frame.
+    void
+    BeginFrame()
+    {
+        upload_ms = 0.0;
+    }
+
+    // Whether there's time left this frame for uploads that can wait.
+    bool
+    CanUpload() const
+    {
+        return upload_ms < UPLOAD_BUDGET_MS;
+    }
+
+    int64_t
+    TotalBytes() const
+    {
+        int64_t result = 0;
+        for(int64_t category_bytes : bytes)
+            result += category_bytes;
+        return result;
+    }
+};
+
+static TextureCache GlobalTextureCache;
+
+TextureResource::~TextureResource()
+{
+    GlobalTextureCache.Forget(*this);
+    // NOTE: Close() takes the renderer down with everything on it, and nulls
+    // GlobalRenderer, before the last few holders let go.
+    if(sdl_texture && GlobalRenderer)
+        SDL_DestroyTexture(sdl_texture);
+}
+
+#endif
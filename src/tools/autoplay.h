@@ -0,0 +1,256 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Autoplay
+
+// The headless tools' game loop. The AI moves both sides, a phase at a time,
+// with the game's own upkeep and win conditions, and the time each part takes
+// is added up as it goes. Include after emblem.cpp.
+
+#ifndef AUTOPLAY_H
+#define AUTOPLAY_H
+
+enum Winner
+{
+    WINNER_NONE, // Still going, or ran out of turns.
+    WINNER_ALLY,
+    WINNER_ENEMY,
+};
+
+string
+GetWinnerString(Winner outcome)
+{
+    switch(outcome)
+    {
+        case WINNER_NONE:  return "draw";
+        case WINNER_ALLY:  return "ally";
+        case WINNER_ENEMY: return "enemy";
+        default: SDL_assert(!"ERROR Unhandled enum in GetWinnerString"); return "";
+    }
+}
+
+// Where a level's time went, outside of the AI's own breakdown.
+enum Section
+{
+    SECTION_LOAD,    // LoadLevel. Up to the caller.
+    SECTION_UPKEEP,  // The start of each phase.
+    SECTION_DECIDE,  // Working out each unit's move. See ai_us for inside it.
+    SECTION_MOVE,    // Walking there.
+    SECTION_FIGHT,   // Rolling and applying fights, and experience.
+    SECTION_CLEANUP, // Clearing out the dead, checking for a winner.
+    SECTIONS,
+};
+
+string
+GetSectionString(Section section)
+{
+    switch(section)
+    {
+        case SECTION_LOAD:    return "load";
+        case SECTION_UPKEEP:  return "upkeep";
+        case SECTION_DECIDE:  return "decide";
+        case SECTION_MOVE:    return "move";
+        case SECTION_FIGHT:   return "fight";
+        case SECTION_CLEANUP: return "cleanup";
+        default: SDL_assert(!"ERROR Unhandled enum in GetSectionString"); return "";
+    }
+}
+
+struct PlayStats
+{
+    int turns = 0;
+    int actions = 0;
+    int fights = 0;
+    int allies_lost = 0;
+    int enemies_lost = 0;
+
+    int phases = 0;
+    double max_phase_ms = 0.0;    // The slowest single phase, one side's moves.
+    double max_decide_us = 0.0;   // The slowest single unit's decision.
+    double section_us[SECTIONS] = {};
+    double ai_us[PROFILE_SECTIONS] = {};
+};
+
+// Times one stretch of a level, into the given section.
+struct SectionTimer
+{
+    double *total;
+    chrono::steady_clock::time_point start;
+
+    SectionTimer(PlayStats *stats, Section section)
+    : total(&stats->section_us[section]),
+      start(chrono::steady_clock::now())
+    {}
+
+    ~SectionTimer()
+    {
+        *total += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    }
+};
+
+// ================================ Playing ====================================
+// Returns who has won, if anyone has yet.
+Winner
+CheckWinner(const Level &level)
+{
+    bool enemies_left = false;
+    bool boss_left = false;
+    for(const shared_ptr<Unit> &unit : level.combatants)
+    {
+        if(unit->should_die)
+        {
+            if(unit->ID() == LEADER_ID)
+                return WINNER_ENEMY;
+            continue;
+        }
+        if(!unit->is_ally)
+            enemies_left = true;
+        if(unit->is_boss)
+            boss_left = true;
+        if(level.objective == OBJECTIVE_CAPTURE && unit->ID() == LEADER_ID &&
+           level.map.tiles[unit->pos.col][unit->pos.row].type == GOAL)
+            return WINNER_ALLY;
+    }
+
+    if(!enemies_left || (level.objective == OBJECTIVE_BOSS && !boss_left))
+        return WINNER_ALLY;
+    return WINNER_NONE;
+}
+
+// One unit's action, start to finish.
+void
+TakeTurn(Unit *unit, Level *level, PlayStats *stats)
+{
+    Tilemap &map = level->map;
+    pair<position, Unit *> action;
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        SectionTimer timer(stats, SECTION_DECIDE);
+        GlobalAIProfiler.BeginDecision(unit->name, unit->turns_active);
+        {
+            ProfileScope profile(PROFILE_OTHER);
+            pair<vector<position>, vector<position>> ranges =
+                CachedAccessibleAndAttackableFrom(map, unit->pos, unit->movement,
+                                                  unit->MinRange(), unit->MaxRange(),
+                                                  unit->is_ally);
+            map.accessible = ranges.first;
+            map.vis_range = ranges.second;
+            map.double_range =
+                CachedAccessibleAndAttackableFrom(map, unit->pos, unit->movement * 2,
+                                                  unit->MinRange(), unit->MaxRange(),
+                                                  unit->is_ally).first;
+            action = GetAction(*unit, map);
+        }
+        GlobalAIProfiler.EndDecision();
+
+        const AIDecisionProfile &decision = GlobalAIProfiler.Get(GlobalAIProfiler.count - 1);
+        for(int i = 0; i < PROFILE_SECTIONS; ++i)
+            stats->ai_us[i] += decision.section_us[i];
+        stats->max_decide_us = max(stats->max_decide_us,
+            chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+    ++stats->actions;
+
+    {
+        SectionTimer timer(stats, SECTION_MOVE);
+
+        // Some behaviors have no answer when they can't find a path. Stay put.
+        position destination = action.first;
+        if(!IsValidBoundsPosition(map.width, map.height, destination) ||
+           (map.tiles[destination.col][destination.row].occupant &&
+            map.tiles[destination.col][destination.row].occupant != unit))
+        {
+            destination = unit->pos;
+            action.second = nullptr;
+        }
+
+        map.tiles[unit->pos.col][unit->pos.row].occupant = nullptr;
+        map.tiles[destination.col][destination.row].occupant = unit;
+        unit->SetPosition(destination);
+    }
+
+    Unit *target = action.second;
+    if(target)
+    {
+        SectionTimer timer(stats, SECTION_FIGHT);
+        FightLog log = ResolveFight(map, *unit, *target,
+                                    [](RngStream stream) { return d100(stream); });
+        ApplyFight(log, unit, target);
+        ++stats->fights;
+
+        Unit *earner = log.one_earns ? unit : target;
+        if(earner->is_ally && !earner->should_die)
+            earner->GrantExperience(log.experience);
+    }
+
+    unit->Deactivate();
+}
+
+// Plays one side's moves. Returns once someone's won, or everyone's moved.
+Winner
+PlayPhase(Level *level, bool player_phase, PlayStats *stats)
+{
+    {
+        SectionTimer timer(stats, SECTION_UPKEEP);
+        level->StartPhase(player_phase);
+    }
+
+    // Units can die partway through, so go by a list made up front.
+    vector<shared_ptr<Unit>> movers = {};
+    for(const shared_ptr<Unit> &unit : level->combatants)
+        if(unit->is_ally == player_phase && unit->ai_behavior != NO_BEHAVIOR)
+            movers.push_back(unit);
+
+    for(const shared_ptr<Unit> &unit : movers)
+    {
+        if(unit->should_die)
+            continue;
+        TakeTurn(unit.get(), level, stats);
+
+        SectionTimer timer(stats, SECTION_CLEANUP);
+        Winner outcome = CheckWinner(*level);
+        for(const shared_ptr<Unit> &dead : level->combatants)
+        {
+            if(dead->should_die)
+            {
+                if(dead->is_ally)
+                    ++stats->allies_lost;
+                else
+                    ++stats->enemies_lost;
+            }
+        }
+        if(outcome == WINNER_ENEMY)
+            return outcome;
+        level->RemoveDeadUnits();
+
+        if(outcome != WINNER_NONE)
+            return outcome;
+    }
+    return WINNER_NONE;
+}
+
+// Plays whole turns, the player's phase then the enemy's, until someone wins
+// or turn_limit turns have gone by.
+Winner
+PlayTurns(Level *level, int turn_limit, PlayStats *stats)
+{
+    Winner outcome = WINNER_NONE;
+    int turn = 1;
+    for(; turn <= turn_limit && outcome == WINNER_NONE; ++turn)
+    {
+        for(bool player_phase : {true, false})
+        {
+            chrono::steady_clock::time_point phase_start = chrono::steady_clock::now();
+            outcome = PlayPhase(level, player_phase, stats);
+            double phase_ms = chrono::duration<double, milli>(
+                chrono::steady_clock::now() - phase_start).count();
+            stats->max_phase_ms = max(stats->max_phase_ms, phase_ms);
+            ++stats->phases;
+            if(outcome != WINNER_NONE)
+                break;
+        }
+    }
+    stats->turns = turn - 1;
+    return outcome;
+}
+
+#endif
@@ -0,0 +1,386 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Balance
+
+// Fights units from units.tsv against each other, over and over, and reports
+// how often each side wins and how much damage gets done. For balancing.
+//
+// usage: ./balance [--fights N] [--seed S] [--threads N] [--distance D]
+//                  [--avoid A B] [--defense A B] [--tsv NAME] ONE TWO
+//
+// ONE and TWO are a unit's name, a comma-separated list of names, or one of
+// "allies", "enemies" or "all". Every unit in ONE attacks every unit in TWO.
+// --avoid and --defense are the terrain bonuses of the tiles ONE and TWO stand
+// on. --tsv writes NAME.tsv, with a row per matchup, and NAME-damage.tsv, with
+// the damage histograms.
+//
+// Fights are worked out by PredictCombat and rolled by SimulateFight, through
+// the same RollStrikes as ResolveFight, so the numbers are the game's own.
+// They're rolled in chunks with seeds of their own, so a run with the same
+// seed comes out the same on any number of threads.
+
+#define HEADLESS 1
+#define EMBLEM_TOOL 1
+#include "../emblem.cpp"
+
+#include <iomanip>
+
+#define DEFAULT_FIGHTS 1000000
+#define FIGHTS_PER_JOB 65536
+#define HISTOGRAM_WIDTH 50
+
+// One unit attacking another, on the given terrain.
+struct Matchup
+{
+    shared_ptr<Unit> one;
+    shared_ptr<Unit> two;
+    Outcome outcome;
+};
+
+// What came of a pile of fights between the same two units.
+struct Tally
+{
+    int64_t fights = 0;
+    int64_t one_dies = 0;
+    int64_t two_dies = 0;
+    int64_t strikes = 0;
+    vector<int64_t> one_damage = {}; // Damage done by one, indexed by amount.
+    vector<int64_t> two_damage = {};
+
+    void
+    Resize(const Matchup &matchup)
+    {
+        one_damage.assign(matchup.two->health + 1, 0);
+        two_damage.assign(matchup.one->health + 1, 0);
+    }
+
+    void
+    Merge(const Tally &other)
+    {
+        fights += other.fights;
+        one_dies += other.one_dies;
+        two_dies += other.two_dies;
+        strikes += other.strikes;
+        for(int i = 0; i < one_damage.size(); ++i)
+            one_damage[i] += other.one_damage[i];
+        for(int i = 0; i < two_damage.size(); ++i)
+            two_damage[i] += other.two_damage[i];
+    }
+};
+
+// ================================ Fighting ===================================
+void
+RollFights(const Matchup &matchup, int64_t count, uint64_t seed, Tally *tally)
+{
+    GlobalRng.Seed(seed);
+    tally->Resize(matchup);
+
+    const Outcome &outcome = matchup.outcome;
+    for(int64_t i = 0; i < count; ++i)
+    {
+        int one_health = matchup.one->health;
+        int two_health = matchup.two->health;
+        int strikes = 0;
+        SimulateFight(outcome, &one_health, &two_health,
+                      [&strikes](RngStream stream)
+                      {
+                          if(stream == RNG_HIT)
+                              ++strikes;
+                          return d100(stream);
+                      });
+
+        ++tally->fights;
+        tally->strikes += strikes;
+        if(!one_health)
+            ++tally->one_dies;
+        if(!two_health)
+            ++tally->two_dies;
+        ++tally->one_damage[matchup.two->health - two_health];
+        ++tally->two_damage[matchup.one->health - one_health];
+    }
+}
+
+// ================================== Rosters ==================================
+// Everyone the argument names. See the usage above.
+vector<shared_ptr<Unit>>
+PickRoster(const vector<shared_ptr<Unit>> &units, const string &arg)
+{
+    vector<shared_ptr<Unit>> roster = {};
+    if(arg == "all" || arg == "allies" || arg == "enemies")
+    {
+        for(const shared_ptr<Unit> &unit : units)
+        {
+            if(arg == "all" || unit->is_ally == (arg == "allies"))
+                roster.push_back(unit);
+        }
+        return roster;
+    }
+
+    stringstream names(arg);
+    string name;
+    while(getline(names, name, ','))
+    {
+        bool found = false;
+        for(const shared_ptr<Unit> &unit : units)
+        {
+            if(unit->name == name)
+            {
+                roster.push_back(unit);
+                found = true;
+                break;
+            }
+        }
+        if(!found)
+            cout << "WARN balance: No unit named " << name << " in " << INITIAL_UNITS << "\n";
+    }
+    return roster;
+}
+
+// ================================ Reporting ==================================
+double
+Share(int64_t part, int64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+// Mean damage done, from a histogram.
+double
+MeanDamage(const vector<int64_t> &histogram, int64_t fights)
+{
+    double total = 0.0;
+    for(int i = 0; i < histogram.size(); ++i)
+        total += (double)i * histogram[i];
+    return fights ? total / fights : 0.0;
+}
+
+void
+PrintHistogram(const string &title, const vector<int64_t> &histogram, int64_t fights)
+{
+    int64_t most = 1;
+    for(int64_t count : histogram)
+        most = max(most, count);
+
+    cout << "\n" << title << "\n";
+    for(int i = 0; i < histogram.size(); ++i)
+    {
+        if(!histogram[i])
+            continue;
+        cout << right << setw(5) << i << " " << setw(7) << fixed << setprecision(2)
+             << Share(histogram[i], fights) << "% "
+             << string((size_t)(HISTOGRAM_WIDTH * histogram[i] / most), '#') << "\n";
+    }
+}
+
+void
+Report(const vector<Matchup> &matchups, const vector<Tally> &tallies)
+{
+    cout << "\n" << left << setw(12) << "one" << setw(12) << "two" << right
+         << setw(6) << "hit" << setw(6) << "dmg" << setw(6) << "2x"
+         << setw(6) << "hit" << setw(6) << "dmg" << setw(6) << "2x"
+         << setw(9) << "one win" << setw(9) << "two win" << setw(9) << "exact"
+         << setw(9) << "one dmg" << setw(9) << "two dmg" << "\n";
+
+    for(int i = 0; i < matchups.size(); ++i)
+    {
+        const Matchup &m = matchups[i];
+        const Outcome &o = m.outcome;
+        const Tally &t = tallies[i];
+        const FightDistribution &exact = DistributeFight(o, m.one->health, m.two->health);
+
+        cout << left << setw(12) << m.one->name << setw(12) << m.two->name << right
+             << setw(6) << o.one_hit << setw(6) << o.one_damage
+             << setw(6) << (o.one_doubles ? "y" : "n")
+             << setw(6) << (o.two_attacks ? to_string(o.two_hit) : "-")
+             << setw(6) << (o.two_attacks ? to_string(o.two_damage) : "-")
+             << setw(6) << (o.two_attacks ? (o.two_doubles ? "y" : "n") : "-")
+             << fixed << setprecision(2)
+             << setw(8) << Share(t.two_dies, t.fights) << "%"
+             << setw(8) << Share(t.one_dies, t.fights) << "%"
+             << setw(8) << 100.0 * exact.two_dies << "%"
+             << setw(9) << MeanDamage(t.one_damage, t.fights)
+             << setw(9) << MeanDamage(t.two_damage, t.fights) << "\n";
+    }
+
+    // Histograms are only readable one matchup at a time.
+    if(matchups.size() == 1)
+    {
+        PrintHistogram("Damage done by " + matchups[0].one->name, tallies[0].one_damage,
+                       tallies[0].fights);
+        PrintHistogram("Damage done by " + matchups[0].two->name, tallies[0].two_damage,
+                       tallies[0].fights);
+    }
+}
+
+// Writes NAME.tsv and NAME-damage.tsv. Returns false if either couldn't be.
+bool
+ExportTSV(const string &name, const vector<Matchup> &matchups, const vector<Tally> &tallies,
+          int distance)
+{
+    ofstream summary(name + ".tsv");
+    ofstream damage(name + "-damage.tsv");
+    if(!summary.is_open() || !damage.is_open())
+    {
+        cout << "ERROR balance: Couldn't open " << name << ".tsv for writing\n";
+        return false;
+    }
+
+    summary << "one\ttwo\tdistance\tfights\tone_hit\tone_damage\tone_crit\tone_doubles"
+            << "\ttwo_attacks\ttwo_hit\ttwo_damage\ttwo_crit\ttwo_doubles"
+            << "\tone_dies\ttwo_dies\tboth_live\tstrikes\tone_mean_damage\ttwo_mean_damage\n";
+    damage << "one\ttwo\tside\tdamage\tfights\n";
+
+    for(int i = 0; i < matchups.size(); ++i)
+    {
+        const Matchup &m = matchups[i];
+        const Outcome &o = m.outcome;
+        const Tally &t = tallies[i];
+
+        summary << m.one->name << "\t" << m.two->name << "\t" << distance << "\t" << t.fights
+                << "\t" << o.one_hit << "\t" << o.one_damage << "\t" << o.one_crit
+                << "\t" << o.one_doubles << "\t" << o.two_attacks << "\t" << o.two_hit
+                << "\t" << o.two_damage << "\t" << o.two_crit << "\t" << o.two_doubles
+                << "\t" << t.one_dies << "\t" << t.two_dies
+                << "\t" << t.fights - t.one_dies - t.two_dies << "\t" << t.strikes
+                << "\t" << MeanDamage(t.one_damage, t.fights)
+                << "\t" << MeanDamage(t.two_damage, t.fights) << "\n";
+
+        for(int amount = 0; amount < t.one_damage.size(); ++amount)
+            damage << m.one->name << "\t" << m.two->name << "\tone\t" << amount
+                   << "\t" << t.one_damage[amount] << "\n";
+        for(int amount = 0; amount < t.two_damage.size(); ++amount)
+            damage << m.one->name << "\t" << m.two->name << "\ttwo\t" << amount
+                   << "\t" << t.two_damage[amount] << "\n";
+    }
+    return true;
+}
+
+// ================================== Main =====================================
+int
+main(int argc, char *argv[])
+{
+    int64_t fights = DEFAULT_FIGHTS;
+    uint64_t seed = 1;
+    int threads = 0;
+    int distance = 1;
+    int one_avoid = 0, two_avoid = 0;
+    int one_defense = 0, two_defense = 0;
+    string tsv = "";
+    vector<string> rosters = {};
+    bool usage = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool has_pair = i + 2 < argc;
+        if(arg == "--fights" && has_value)
+            fights = stoll(argv[++i]);
+        else if(arg == "--seed" && has_value)
+            seed = stoull(argv[++i]);
+        else if(arg == "--threads" && has_value)
+            threads = stoi(argv[++i]);
+        else if(arg == "--distance" && has_value)
+            distance = stoi(argv[++i]);
+        else if(arg == "--avoid" && has_pair)
+        {
+            one_avoid = stoi(argv[++i]);
+            two_avoid = stoi(argv[++i]);
+        }
+        else if(arg == "--defense" && has_pair)
+        {
+            one_defense = stoi(argv[++i]);
+            two_defense = stoi(argv[++i]);
+        }
+        else if(arg == "--tsv" && has_value)
+            tsv = argv[++i];
+        else if(arg[0] != '-')
+            rosters.push_back(arg);
+        else
+            usage = true;
+    }
+
+    if(usage || rosters.size() != 2 || fights <= 0)
+    {
+        cout << "usage: balance [--fights N] [--seed S] [--threads N] [--distance D]\n"
+             << "               [--avoid A B] [--defense A B] [--tsv NAME] ONE TWO\n";
+        return 1;
+    }
+
+    LoadSounds();
+    vector<shared_ptr<Unit>> units = LoadUnits(DATA_PATH + string(INITIAL_UNITS));
+    vector<shared_ptr<Unit>> ones = PickRoster(units, rosters[0]);
+    vector<shared_ptr<Unit>> twos = PickRoster(units, rosters[1]);
+    if(ones.empty() || twos.empty())
+    {
+        cout << "ERROR balance: Nobody to fight.\n";
+        return 1;
+    }
+
+    vector<Matchup> matchups = {};
+    for(const shared_ptr<Unit> &one : ones)
+    {
+        for(const shared_ptr<Unit> &two : twos)
+        {
+            Matchup matchup = {one, two,
+                               PredictCombat(*one, *two, distance,
+                                             one_avoid, two_avoid,
+                                             one_defense, two_defense)};
+            matchups.push_back(matchup);
+        }
+    }
+
+    GlobalJobs.Start(threads);
+    cout << "Fighting " << matchups.size() << " matchups, " << fights
+         << " fights each, seed " << seed << ", " << GlobalJobs.Size() << " threads.\n";
+
+    // Each chunk is rolled into its own tally, then they're added up here.
+    int64_t chunks_per_matchup = (fights + FIGHTS_PER_JOB - 1) / FIGHTS_PER_JOB;
+    vector<Tally> chunks(matchups.size() * chunks_per_matchup);
+    WaitGroup running;
+    running.Add((int)chunks.size());
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int m = 0; m < matchups.size(); ++m)
+    {
+        for(int64_t c = 0; c < chunks_per_matchup; ++c)
+        {
+            GlobalJobs.Submit([&, m, c]()
+                {
+                    int64_t count = min((int64_t)FIGHTS_PER_JOB, fights - c * FIGHTS_PER_JOB);
+                    uint64_t chunk_seed = Mix64(seed ^ Mix64(((uint64_t)m << 32) + c));
+                    RollFights(matchups[m], count, chunk_seed,
+                               &chunks[m * chunks_per_matchup + c]);
+                    running.Done();
+                });
+        }
+    }
+    running.Wait();
+    double wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<Tally> tallies(matchups.size());
+    for(int m = 0; m < matchups.size(); ++m)
+    {
+        tallies[m].Resize(matchups[m]);
+        for(int64_t c = 0; c < chunks_per_matchup; ++c)
+            tallies[m].Merge(chunks[m * chunks_per_matchup + c]);
+    }
+
+    Report(matchups, tallies);
+    double total = (double)fights * matchups.size();
+    cout << "\n" << fixed << setprecision(2) << total / 1e6 << " M fights in "
+         << wall_seconds << " s, " << (wall_seconds > 0.0 ? total / wall_seconds / 1e6 : 0.0)
+         << " M fights/s\n";
+
+    int status = 0;
+    if(!tsv.empty())
+    {
+        if(ExportTSV(tsv, matchups, tallies, distance))
+            cout << "Wrote " << tsv << ".tsv and " << tsv << "-damage.tsv\n";
+        else
+            status = 1;
+    }
+
+    GlobalJobs.Stop();
+    UnloadSounds();
+    return status;
+}
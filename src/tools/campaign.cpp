@@ -0,0 +1,238 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Campaign
+
+// Plays the whole campaign through, headless, with the AI moving both sides,
+// and writes out how long each level took and where the time went. Run it
+// before and after a change to catch anything that got slower.
+//
+// usage: ./campaign [--seed S] [--turns N] [--ally-behavior B] [--json FILE]
+//                   [level.txt ...]
+//
+// With no levels given, plays CampaignLevels() in order. The survivors of each
+// level carry on to the next, the same as in the game. Allies without a
+// behavior of their own are given --ally-behavior, which defaults to PURSUE.
+// A level that runs out of turns is called a draw. One that loses the leader
+// is played on from as if it had been skipped, with the party that went in, so
+// every level gets run either way. Turns are played by autoplay.h.
+//
+// Runs on one thread, so the timings aren't muddied by other work. The same
+// seed always plays out the same, down to the board hash each level ends on.
+
+#define HEADLESS 1
+#define EMBLEM_TOOL 1
+#include "../emblem.cpp"
+#include "autoplay.h"
+
+#include <iomanip>
+#include <sys/resource.h>
+
+#define DEFAULT_TURN_LIMIT 50
+#define DEFAULT_JSON "campaign.json"
+
+struct LevelResult : PlayStats
+{
+    string name = "";
+    uint64_t seed = 0;      // The battle's own seed. The game rolls the same with
+                            // --level and --seed, from units.tsv's party.
+    Winner outcome = WINNER_NONE;
+    int party = 0;          // Allies who made it to the end.
+    uint64_t hash = 0;      // The board, as the level ended.
+
+    double wall_ms = 0.0;
+    long peak_kb = 0;       // The process's high water mark, as of the end.
+};
+
+long
+PeakMemoryKB()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // NOTE: Kilobytes on Linux, bytes on macOS.
+}
+
+// ================================ Playing ====================================
+LevelResult
+PlayLevel(const string &name, const vector<shared_ptr<Unit>> &units,
+          vector<shared_ptr<Unit>> *party, AIBehavior ally_behavior, int turn_limit)
+{
+    LevelResult result = {};
+    result.name = name;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    Level level;
+    {
+        SectionTimer timer(&result, SECTION_LOAD);
+        level = LoadLevel(DATA_PATH + name, units, *party);
+    }
+    result.seed = level.seed;
+    for(const shared_ptr<Unit> &unit : level.combatants)
+        if(unit->is_ally && unit->ai_behavior == NO_BEHAVIOR)
+            unit->ai_behavior = ally_behavior;
+
+    GlobalMovementCache.Clear();
+    GlobalActionCache.Clear();
+
+    result.outcome = PlayTurns(&level, turn_limit, &result);
+    result.hash = level.map.Hash();
+    // LoadLevel() plays with copies, so the party that went in is still as it
+    // was if this one's lost.
+    if(result.outcome != WINNER_ENEMY)
+        *party = CarryParty(level);
+    result.party = (int)party->size();
+    result.wall_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    result.peak_kb = PeakMemoryKB();
+    return result;
+}
+
+// ================================ Reporting ==================================
+void
+Report(const vector<LevelResult> &results, double wall_ms)
+{
+    cout << fixed << setprecision(2);
+    cout << left << setw(10) << "level" << right
+         << setw(8) << "result" << setw(7) << "turns" << setw(9) << "actions"
+         << setw(7) << "party" << setw(11) << "wall ms" << setw(13) << "max phase"
+         << setw(11) << "peak KB" << "\n";
+    for(const LevelResult &result : results)
+    {
+        cout << left << setw(10) << result.name << right
+             << setw(8) << GetWinnerString(result.outcome)
+             << setw(7) << result.turns
+             << setw(9) << result.actions
+             << setw(7) << result.party
+             << setw(11) << result.wall_ms
+             << setw(13) << result.max_phase_ms
+             << setw(11) << result.peak_kb << "\n";
+    }
+
+    cout << "\n" << left << setw(10) << "ms" << right;
+    for(int i = 0; i < SECTIONS; ++i)
+        cout << setw(10) << GetSectionString((Section)i);
+    cout << "\n";
+    for(const LevelResult &result : results)
+    {
+        cout << left << setw(10) << result.name << right;
+        for(int i = 0; i < SECTIONS; ++i)
+            cout << setw(10) << result.section_us[i] / 1000.0;
+        cout << "\n";
+    }
+    cout << "\ntotal: " << wall_ms << " ms\n";
+}
+
+// Numbers only, and names that need no escaping, so this is all it takes.
+void
+WriteJSON(const string &filename, const vector<LevelResult> &results,
+          uint64_t seed, int turn_limit, AIBehavior ally_behavior, double wall_ms)
+{
+    ofstream fp(filename);
+    if(!fp.is_open())
+    {
+        cout << "WARN campaign: Couldn't open " << filename << "\n";
+        return;
+    }
+
+    int completed = 0;
+    for(const LevelResult &result : results)
+        completed += result.outcome == WINNER_ALLY;
+
+    fp << fixed << setprecision(3);
+    fp << "{\n";
+    fp << "  \"seed\": " << seed << ",\n";
+    fp << "  \"turn_limit\": " << turn_limit << ",\n";
+    fp << "  \"ally_behavior\": \"" << GetBehaviorString(ally_behavior) << "\",\n";
+    fp << "  \"wall_ms\": " << wall_ms << ",\n";
+    fp << "  \"peak_kb\": " << PeakMemoryKB() << ",\n";
+    fp << "  \"levels_won\": " << completed << ",\n";
+    fp << "  \"levels\": [\n";
+    for(int r = 0; r < results.size(); ++r)
+    {
+        const LevelResult &result = results[r];
+        fp << "    {\n";
+        fp << "      \"name\": \"" << result.name << "\",\n";
+        fp << "      \"seed\": " << result.seed << ",\n";
+        fp << "      \"outcome\": \"" << GetWinnerString(result.outcome) << "\",\n";
+        fp << "      \"turns\": " << result.turns << ",\n";
+        fp << "      \"actions\": " << result.actions << ",\n";
+        fp << "      \"fights\": " << result.fights << ",\n";
+        fp << "      \"allies_lost\": " << result.allies_lost << ",\n";
+        fp << "      \"enemies_lost\": " << result.enemies_lost << ",\n";
+        fp << "      \"party\": " << result.party << ",\n";
+        fp << "      \"board_hash\": \"" << hex << result.hash << dec << "\",\n";
+        fp << "      \"wall_ms\": " << result.wall_ms << ",\n";
+        fp << "      \"phases\": " << result.phases << ",\n";
+        fp << "      \"mean_phase_ms\": " << (result.phases ? result.wall_ms / result.phases : 0.0) << ",\n";
+        fp << "      \"max_phase_ms\": " << result.max_phase_ms << ",\n";
+        fp << "      \"peak_kb\": " << result.peak_kb << ",\n";
+
+        fp << "      \"sections_ms\": {";
+        for(int i = 0; i < SECTIONS; ++i)
+            fp << (i ? ", " : "") << "\"" << GetSectionString((Section)i) << "\": "
+               << result.section_us[i] / 1000.0;
+        fp << "},\n";
+
+        fp << "      \"ai_ms\": {";
+        for(int i = 0; i < PROFILE_SECTIONS; ++i)
+            fp << (i ? ", " : "") << "\"" << GetProfileSectionString((ProfileSection)i) << "\": "
+               << result.ai_us[i] / 1000.0;
+        fp << "}\n";
+        fp << "    }" << (r + 1 < results.size() ? "," : "") << "\n";
+    }
+    fp << "  ]\n";
+    fp << "}\n";
+}
+
+// ================================== Main =====================================
+int
+main(int argc, char *argv[])
+{
+    uint64_t seed = 1;
+    int turn_limit = DEFAULT_TURN_LIMIT;
+    AIBehavior ally_behavior = PURSUE;
+    string json = DEFAULT_JSON;
+    vector<string> level_names = {};
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "--seed" && has_value)
+            seed = stoull(argv[++i]);
+        else if(arg == "--turns" && has_value)
+            turn_limit = stoi(argv[++i]);
+        else if(arg == "--ally-behavior" && has_value)
+            ally_behavior = (AIBehavior)stoi(argv[++i]);
+        else if(arg == "--json" && has_value)
+            json = argv[++i];
+        else if(arg[0] != '-')
+            level_names.push_back(arg);
+        else
+        {
+            cout << "usage: campaign [--seed S] [--turns N] [--ally-behavior B] [--json FILE]\n"
+                 << "                [level.txt ...]\n";
+            return 1;
+        }
+    }
+    if(level_names.empty())
+        level_names = CampaignLevels();
+
+    LoadSounds();
+    vector<shared_ptr<Unit>> units = LoadUnits(DATA_PATH + string(INITIAL_UNITS));
+    vector<shared_ptr<Unit>> party = {};
+
+    cout << "Playing " << level_names.size() << " levels, seed " << seed << ".\n";
+    GlobalRng.Begin(seed);
+
+    vector<LevelResult> results = {};
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(const string &name : level_names)
+        results.push_back(PlayLevel(name, units, &party, ally_behavior, turn_limit));
+    double wall_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    Report(results, wall_ms);
+    WriteJSON(json, results, seed, turn_limit, ally_behavior, wall_ms);
+    cout << "Wrote " << json << "\n";
+
+    UnloadSounds();
+    return 0;
+}
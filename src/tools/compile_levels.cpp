@@ -0,0 +1,149 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Compile Levels
+
+// Compiles the level text files into the packed format in compile.h, which
+// LoadLevel() takes over the text from then on. Run it again after editing a
+// level. Until then, the game warns that the compiled copy is stale and reads
+// the text instead.
+//
+// usage: ./compile_levels [--repeat N] [level.txt ...]
+//
+// With no levels given, compiles CampaignLevels(). Each compiled level is
+// loaded back and checked against the text before moving on, and both ways of
+// loading are timed, N times each.
+
+#define HEADLESS 1
+#define EMBLEM_TOOL 1
+#include "../emblem.cpp"
+
+#include <iomanip>
+
+#define DEFAULT_REPEAT 100
+
+bool
+SameConversation(const Conversation &a, const Conversation &b)
+{
+    if(a.filename != b.filename || !(a.pos == b.pos) || a.one != b.one || a.two != b.two ||
+       a.song != b.song || a.prose.size() != b.prose.size())
+        return false;
+    for(int i = 0; i < a.prose.size(); ++i)
+        if(a.prose[i].speaker != b.prose[i].speaker || a.prose[i].text != b.prose[i].text ||
+           a.prose[i].expression != b.prose[i].expression || a.prose[i].event != b.prose[i].event)
+            return false;
+    return true;
+}
+
+// Whether two loads of a level came out the same, as far as the file says.
+bool
+SameLevel(const Level &a, const Level &b)
+{
+    if(a.objective != b.objective ||
+       a.map.width != b.map.width || a.map.height != b.map.height ||
+       a.map.atlas.filename != b.map.atlas.filename ||
+       (a.song ? a.song->name : "") != (b.song ? b.song->name : "") ||
+       a.combatants.size() != b.combatants.size())
+        return false;
+
+    for(int col = 0; col < a.map.width; ++col)
+        for(int row = 0; row < a.map.height; ++row)
+            if(a.map.tiles[col][row].type != b.map.tiles[col][row].type)
+                return false;
+
+    for(int i = 0; i < a.combatants.size(); ++i)
+    {
+        const Unit &one = *a.combatants[i];
+        const Unit &two = *b.combatants[i];
+        if(one.name != two.name || !(one.pos == two.pos) ||
+           one.ai_behavior != two.ai_behavior || one.is_boss != two.is_boss ||
+           b.map.tiles[two.pos.col][two.pos.row].occupant != &two)
+            return false;
+    }
+
+    auto same_conversations = [](const vector<Conversation> &one, const vector<Conversation> &two)
+    {
+        if(one.size() != two.size())
+            return false;
+        for(int i = 0; i < one.size(); ++i)
+            if(!SameConversation(one[i], two[i]))
+                return false;
+        return true;
+    };
+    return SameConversation(a.conversations.prelude, b.conversations.prelude) &&
+           same_conversations(a.conversations.mid_battle, b.conversations.mid_battle) &&
+           same_conversations(a.conversations.villages, b.conversations.villages) &&
+           same_conversations(a.conversations.list, b.conversations.list);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int repeat = DEFAULT_REPEAT;
+    vector<string> level_names = {};
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg == "--repeat" && i + 1 < argc)
+            repeat = max(1, stoi(argv[++i]));
+        else if(arg[0] != '-')
+            level_names.push_back(arg);
+        else
+        {
+            cout << "usage: compile_levels [--repeat N] [level.txt ...]\n";
+            return 1;
+        }
+    }
+    if(level_names.empty())
+        level_names = CampaignLevels();
+
+    LoadSounds();
+    vector<shared_ptr<Unit>> units = LoadUnits(DATA_PATH + string(INITIAL_UNITS));
+
+    cout << fixed << setprecision(1);
+    cout << left << setw(14) << "level" << right << setw(8) << "bytes"
+         << setw(12) << "text us" << setw(14) << "compiled us" << "\n";
+
+    int failed = 0;
+    for(const string &name : level_names)
+    {
+        string compiled = CompiledLevelName(DATA_PATH + name);
+        Level text = LoadLevelText(name, units, {});
+        if(!CompileLevel(text, compiled))
+        {
+            ++failed;
+            continue;
+        }
+
+        Level packed;
+        if(!LoadCompiledLevel(name, units, {}, &packed) || !SameLevel(text, packed))
+        {
+            cout << "ERROR compile_levels: " << compiled << " doesn't load back the same. "
+                 << "Removing it.\n";
+            remove(compiled.c_str());
+            ++failed;
+            continue;
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for(int i = 0; i < repeat; ++i)
+            Level level = LoadLevelText(name, units, {});
+        double text_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        for(int i = 0; i < repeat; ++i)
+        {
+            Level level;
+            LoadCompiledLevel(name, units, {}, &level);
+        }
+        double compiled_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        struct stat info = {};
+        stat(compiled.c_str(), &info);
+        cout << left << setw(14) << name << right << setw(8) << info.st_size
+             << setw(12) << text_us / repeat << setw(14) << compiled_us / repeat << "\n";
+    }
+
+    UnloadSounds();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Load Bench
+
+// Times loading every content file the game reads as text, and counts the
+// allocations each load makes. Run it before and after touching the loaders.
+//
+// usage: ./load_bench [--repeat N]
+//
+// Loads go through the game's own LoadUnits, LoadLevelText and
+// LoadConversation, N times each, so the numbers include building what was
+// loaded (units, conversations, textures) as well as reading it. The "parse"
+// column is LineParser alone, walking every field of the file.
+
+#define HEADLESS 1
+#define EMBLEM_TOOL 1
+#include "../emblem.cpp"
+
+#include <dirent.h>
+#include <iomanip>
+#include <new>
+
+#define DEFAULT_REPEAT 200
+
+// Every allocation in the program goes through these.
+static uint64_t GlobalAllocations = 0;
+
+void *
+operator new(size_t size)
+{
+    ++GlobalAllocations;
+    void *result = malloc(size ? size : 1);
+    if(!result)
+        throw bad_alloc();
+    return result;
+}
+
+void
+operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void
+operator delete(void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+struct Measure
+{
+    double us = 0.0;          // Per load.
+    double allocations = 0.0; // Per load.
+};
+
+template <typename Load>
+Measure
+Time(int repeat, Load load)
+{
+    uint64_t allocations = GlobalAllocations;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int i = 0; i < repeat; ++i)
+        load();
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    return {us / repeat, (double)(GlobalAllocations - allocations) / repeat};
+}
+
+// Walks every field of every line, and nothing else.
+int
+ParseOnly(const string &filename, char sep)
+{
+    LineParser parser;
+    if(!parser.Open(filename))
+        return 0;
+    int fields = 0;
+    while(parser.NextLine())
+        while(!parser.Field(sep).empty())
+            ++fields;
+    return fields;
+}
+
+vector<string>
+ListTextFiles(const string &path)
+{
+    vector<string> result = {};
+    DIR *dir = opendir(path.c_str());
+    if(!dir)
+        return result;
+
+    while(dirent *entry = readdir(dir))
+    {
+        string name = entry->d_name;
+        if(name.size() > 4 && name.substr(name.size() - 4) == ".txt")
+            result.push_back(name);
+    }
+    closedir(dir);
+
+    sort(result.begin(), result.end());
+    return result;
+}
+
+void
+Row(const string &name, const Measure &load, const Measure &parse)
+{
+    cout << left << setw(32) << name << right
+         << setw(10) << load.us << setw(10) << load.allocations
+         << setw(10) << parse.us << setw(10) << parse.allocations << "\n";
+}
+
+int
+main(int argc, char *argv[])
+{
+    int repeat = DEFAULT_REPEAT;
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg == "--repeat" && i + 1 < argc)
+            repeat = max(1, stoi(argv[++i]));
+        else
+        {
+            cout << "usage: load_bench [--repeat N]\n";
+            return 1;
+        }
+    }
+
+    LoadSounds();
+    string units_file = DATA_PATH + string(INITIAL_UNITS);
+    vector<shared_ptr<Unit>> units = LoadUnits(units_file);
+
+    cout << fixed << setprecision(1);
+    cout << left << setw(32) << "file" << right
+         << setw(10) << "load us" << setw(10) << "allocs"
+         << setw(10) << "parse us" << setw(10) << "allocs" << "\n";
+
+    Measure total = {};
+    auto add = [&total](const Measure &measure)
+    {
+        total.us += measure.us;
+        total.allocations += measure.allocations;
+    };
+
+    Measure load = Time(repeat, [&]() { LoadUnits(units_file); });
+    Row(INITIAL_UNITS, load, Time(repeat, [&]() { ParseOnly(units_file, '\t'); }));
+    add(load);
+
+    for(const string &name : ListTextFiles(DATA_PATH))
+    {
+        if(name[0] != 'l' || !isdigit(name[1]))
+            continue;
+        load = Time(repeat, [&]() { LoadLevelText(name, units, {}); });
+        Row(name, load, Time(repeat, [&]() { ParseOnly(DATA_PATH + name, ' '); }));
+        add(load);
+    }
+
+    for(const string &path : {string(CONVERSATIONS_PATH), string(VILLAGES_PATH), string(PRELUDES_PATH)})
+    {
+        for(const string &name : ListTextFiles(path))
+        {
+            load = Time(repeat, [&]() { LoadConversation(path, name, units); });
+            Row(name, load, Time(repeat, [&]() { ParseOnly(path + name, ' '); }));
+            add(load);
+        }
+    }
+
+    cout << left << setw(32) << "total" << right
+         << setw(10) << total.us << setw(10) << total.allocations << "\n";
+
+    UnloadSounds();
+    return 0;
+}
@@ -0,0 +1,178 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Predict Bench
+
+// Times PredictCombat one pair at a time against the batched predictor, with
+// every kernel this machine can run, and checks that every field of every
+// outcome comes out the same.
+//
+// usage: ./predict_bench [--pairs N] [--rounds N] [--seed S]
+//
+// Pairs are drawn from units.tsv, with random distances, terrain and buffs.
+
+#define HEADLESS 1
+#define EMBLEM_TOOL 1
+#include "../emblem.cpp"
+
+#include <iomanip>
+
+#define DEFAULT_PAIRS 65536
+#define DEFAULT_ROUNDS 100
+
+struct Matchup
+{
+    int one; // Index into the roster.
+    int two;
+    int distance;
+    int one_avoid_bonus;
+    int two_avoid_bonus;
+    int one_defense_bonus;
+    int two_defense_bonus;
+};
+
+bool
+SameOutcome(const Outcome &a, const Outcome &b)
+{
+    return a.one_attacks == b.one_attacks && a.one_doubles == b.one_doubles &&
+           a.one_damage == b.one_damage && a.one_hit == b.one_hit &&
+           a.one_crit == b.one_crit && a.two_attacks == b.two_attacks &&
+           a.two_doubles == b.two_doubles && a.two_damage == b.two_damage &&
+           a.two_hit == b.two_hit && a.two_crit == b.two_crit;
+}
+
+// Seconds per call of the given function, over a number of rounds.
+template <typename Work>
+double
+Time(int rounds, Work work)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int round = 0; round < rounds; ++round)
+        work();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+}
+
+void
+Report(const string &name, int pairs, double seconds)
+{
+    cout << left << setw(24) << name
+         << right << setw(12) << fixed << setprecision(1) << pairs / seconds / 1e6 << " M/s"
+         << setw(12) << setprecision(2) << seconds * 1e9 / pairs << " ns/pair\n";
+}
+
+int
+main(int argc, char *argv[])
+{
+    int pairs = DEFAULT_PAIRS;
+    int rounds = DEFAULT_ROUNDS;
+    uint64_t seed = 1;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "--pairs" && has_value)
+            pairs = stoi(argv[++i]);
+        else if(arg == "--rounds" && has_value)
+            rounds = stoi(argv[++i]);
+        else if(arg == "--seed" && has_value)
+            seed = stoull(argv[++i]);
+        else
+        {
+            cout << "usage: predict_bench [--pairs N] [--rounds N] [--seed S]\n";
+            return 1;
+        }
+    }
+
+    LoadSounds();
+    vector<shared_ptr<Unit>> units = LoadUnits(DATA_PATH + string(INITIAL_UNITS));
+    if(units.empty())
+    {
+        cout << "ERROR predict_bench: No units in " << INITIAL_UNITS << "\n";
+        return 1;
+    }
+
+    // A buffed and unbuffed copy of everyone, so every formula gets exercised.
+    Rng rng(seed);
+    const Stat buffs[] = {STAT_ATTACK, STAT_DEFENSE, STAT_SPEED, STAT_MAGIC};
+    vector<shared_ptr<Unit>> roster = {};
+    for(const shared_ptr<Unit> &unit : units)
+    {
+        roster.push_back(make_shared<Unit>(*unit));
+        shared_ptr<Unit> buffed = make_shared<Unit>(*unit);
+        buffed->ApplyBuff(new Buff(buffs[rng.Next() % 4], (int)(rng.Next() % 10) + 1, 1));
+        roster.push_back(buffed);
+    }
+
+    const int avoids[] = {0, 10, 20};
+    const int defenses[] = {0, 2, 4};
+    vector<Matchup> matchups = {};
+    for(int i = 0; i < pairs; ++i)
+    {
+        Matchup matchup = {(int)(rng.Next() % roster.size()),
+                           (int)(rng.Next() % roster.size()),
+                           (int)(rng.Next() % 3) + 1,
+                           avoids[rng.Next() % 3], avoids[rng.Next() % 3],
+                           defenses[rng.Next() % 3], defenses[rng.Next() % 3]};
+        matchups.push_back(matchup);
+    }
+
+    const PredictKernel &best = BestPredictKernel();
+    cout << "Predicting " << pairs << " pairs, " << rounds << " rounds, "
+         << best.name << " kernel (" << best.lanes << " lanes) by default.\n\n";
+
+    // One at a time, through the units.
+    vector<Outcome> expected(pairs);
+    double one_at_a_time = Time(rounds, [&]()
+        {
+            for(int i = 0; i < pairs; ++i)
+            {
+                const Matchup &m = matchups[i];
+                expected[i] = PredictCombat(*roster[m.one], *roster[m.two], m.distance,
+                                            m.one_avoid_bonus, m.two_avoid_bonus,
+                                            m.one_defense_bonus, m.two_defense_bonus);
+            }
+        });
+
+    // Packing, with everyone's stats read off of them once up front.
+    vector<CombatantStats> stats = {};
+    for(const shared_ptr<Unit> &unit : roster)
+        stats.push_back(CombatantStats::From(*unit));
+    CombatBatch batch;
+    batch.Reserve(pairs);
+    double packing = Time(rounds, [&]()
+        {
+            batch.Clear();
+            for(const Matchup &m : matchups)
+                batch.Add(stats[m.one], stats[m.two], m.distance,
+                          m.one_avoid_bonus, m.two_avoid_bonus,
+                          m.one_defense_bonus, m.two_defense_bonus);
+        });
+
+    OutcomeBatch scalar;
+    double scalar_rows = Time(rounds, [&]() { PredictCombatBatchScalar(batch, &scalar); });
+
+    int mismatches = 0;
+    int checked = pairs;
+    for(int i = 0; i < pairs; ++i)
+        if(!SameOutcome(expected[i], scalar.Get(i)))
+            ++mismatches;
+
+    Report("PredictCombat", pairs, one_at_a_time);
+    Report("CombatBatch.Add", pairs, packing);
+    Report("batch, rows", pairs, scalar_rows);
+
+    for(const PredictKernel &kernel : PredictKernels())
+    {
+        OutcomeBatch outcomes;
+        double seconds = Time(rounds, [&]() { PredictCombatBatch(batch, &outcomes, kernel); });
+        for(int i = 0; i < pairs; ++i)
+            if(!SameOutcome(expected[i], outcomes.Get(i)))
+                ++mismatches;
+        checked += pairs;
+        Report(string("batch, ") + kernel.name, pairs, seconds);
+    }
+    cout << "\nmismatches: " << mismatches << " of " << checked << "\n";
+
+    UnloadSounds();
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,282 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Tournament
+
+// Plays the AI against itself on the game's levels, headless and in parallel,
+// and reports how each behavior fares. For benchmarking and tuning the AI.
+//
+// usage: ./tournament [--games N] [--seed S] [--threads N] [--turns N]
+//                     [--ally-behavior B] [level.txt ...]
+//
+// With no levels given, plays every data/l*.txt. Allies without a behavior of
+// their own (all of them, in units.tsv) are given --ally-behavior, which
+// defaults to PURSUE. Fights are rolled from a per-game seed, so a run with
+// the same seed and game count always plays out the same. Turns are played by
+// autoplay.h, the same as in the campaign runner.
+
+#define HEADLESS 1
+#define EMBLEM_TOOL 1
+#include "../emblem.cpp"
+#include "autoplay.h"
+
+#include <dirent.h>
+#include <iomanip>
+
+#define BEHAVIOR_COUNT (TREASURE_THEN_FLEE + 1)
+#define DEFAULT_GAMES 1000
+#define DEFAULT_TURN_LIMIT 50
+
+struct GameResult : PlayStats
+{
+    int level = 0;
+    Winner winner = WINNER_NONE; // None if it ran out of turns.
+
+    // Per behavior. Counted once per unit on the field.
+    int fielded[BEHAVIOR_COUNT] = {};
+    int survived[BEHAVIOR_COUNT] = {};
+    int won[BEHAVIOR_COUNT] = {};
+};
+
+// ================================ Playing ====================================
+// Gives a game its own copy of the level, so games can run side by side.
+Level
+CopyLevel(const Level &source, AIBehavior ally_behavior)
+{
+    Level level;
+    level.objective = source.objective;
+    level.name = source.name;
+    level.seed = source.seed;
+    level.spawned = source.spawned;
+    level.map = source.map;
+    for(int col = 0; col < level.map.width; ++col)
+        for(int row = 0; row < level.map.height; ++row)
+            level.map.tiles[col][row].occupant = nullptr;
+
+    for(const shared_ptr<Unit> &original : source.combatants)
+    {
+        shared_ptr<Unit> unit = make_shared<Unit>(*original);
+        unit->SetPosition(original->pos);
+        unit->is_boss = original->is_boss;
+        if(unit->is_ally && unit->ai_behavior == NO_BEHAVIOR)
+            unit->ai_behavior = ally_behavior;
+
+        level.map.tiles[unit->pos.col][unit->pos.row].occupant = unit.get();
+        level.combatants.push_back(unit);
+    }
+    return level;
+}
+
+// Plays one game to the end, or until the turn limit.
+GameResult
+PlayGame(const Level &source, int level_index, AIBehavior ally_behavior,
+         int turn_limit, uint64_t seed)
+{
+    GameResult result = {};
+    result.level = level_index;
+
+    GlobalRng.Seed(seed);
+    Level level = CopyLevel(source, ally_behavior);
+    // NOTE: The dead are taken off the board as they go. Everyone's counted.
+    vector<shared_ptr<Unit>> fielded = level.combatants;
+
+    result.winner = PlayTurns(&level, turn_limit, &result);
+
+    for(const shared_ptr<Unit> &unit : fielded)
+    {
+        int behavior = unit->ai_behavior;
+        ++result.fielded[behavior];
+        if(!unit->should_die)
+            ++result.survived[behavior];
+        if((unit->is_ally && result.winner == WINNER_ALLY) ||
+           (!unit->is_ally && result.winner == WINNER_ENEMY))
+            ++result.won[behavior];
+    }
+
+    return result;
+}
+
+// ================================ Reporting ==================================
+string
+Percent(int part, int whole)
+{
+    if(!whole)
+        return "-";
+    stringstream out;
+    out << fixed << setprecision(1) << (100.0 * part / whole) << "%";
+    return out.str();
+}
+
+void
+Report(const vector<GameResult> &results, const vector<string> &level_names,
+       double wall_seconds, int threads)
+{
+    cout << fixed << setprecision(2);
+
+    int decisions = 0;
+    double decision_ms = 0.0;
+    double max_decision_ms = 0.0;
+    for(const GameResult &result : results)
+    {
+        decisions += result.actions;
+        decision_ms += result.section_us[SECTION_DECIDE] / 1000.0;
+        max_decision_ms = max(max_decision_ms, result.max_decide_us / 1000.0);
+    }
+
+    cout << "\n=== Overall ===\n";
+    cout << "games:           " << results.size() << " on " << threads << " threads\n";
+    cout << "wall time:       " << wall_seconds << " s\n";
+    cout << "games/sec:       " << (wall_seconds > 0.0 ? results.size() / wall_seconds : 0.0) << "\n";
+    cout << "decisions:       " << decisions << "\n";
+    cout << "decision time:   " << (decisions ? 1000.0 * decision_ms / decisions : 0.0)
+         << " us mean, " << 1000.0 * max_decision_ms << " us max\n";
+
+    cout << "\n=== Levels ===\n";
+    cout << left << setw(14) << "level" << right
+         << setw(8) << "games" << setw(10) << "ally" << setw(10) << "enemy"
+         << setw(10) << "draw" << setw(10) << "turns" << setw(14) << "us/decision" << "\n";
+    for(int i = 0; i < level_names.size(); ++i)
+    {
+        int games = 0, ally = 0, enemy = 0, draw = 0, turns = 0, level_decisions = 0;
+        double level_ms = 0.0;
+        for(const GameResult &result : results)
+        {
+            if(result.level != i)
+                continue;
+            ++games;
+            turns += result.turns;
+            level_decisions += result.actions;
+            level_ms += result.section_us[SECTION_DECIDE] / 1000.0;
+            if(result.winner == WINNER_ALLY) ++ally;
+            else if(result.winner == WINNER_ENEMY) ++enemy;
+            else ++draw;
+        }
+        cout << left << setw(14) << level_names[i] << right
+             << setw(8) << games
+             << setw(10) << Percent(ally, games)
+             << setw(10) << Percent(enemy, games)
+             << setw(10) << Percent(draw, games)
+             << setw(10) << (games ? (double)turns / games : 0.0)
+             << setw(14) << (level_decisions ? 1000.0 * level_ms / level_decisions : 0.0) << "\n";
+    }
+
+    cout << "\n=== Behaviors ===\n";
+    cout << left << setw(20) << "behavior" << right
+         << setw(10) << "units" << setw(10) << "won" << setw(12) << "survived" << "\n";
+    for(int behavior = 0; behavior < BEHAVIOR_COUNT; ++behavior)
+    {
+        int fielded = 0, survived = 0, won = 0;
+        for(const GameResult &result : results)
+        {
+            fielded += result.fielded[behavior];
+            survived += result.survived[behavior];
+            won += result.won[behavior];
+        }
+        if(!fielded)
+            continue;
+        cout << left << setw(20) << GetBehaviorString((AIBehavior)behavior) << right
+             << setw(10) << fielded
+             << setw(10) << Percent(won, fielded)
+             << setw(12) << Percent(survived, fielded) << "\n";
+    }
+}
+
+// ================================== Main =====================================
+// Finds data/l*.txt, in order.
+vector<string>
+FindLevels()
+{
+    vector<string> result = {};
+    DIR *dir = opendir(DATA_PATH);
+    if(!dir)
+        return result;
+
+    while(dirent *entry = readdir(dir))
+    {
+        string name = entry->d_name;
+        if(name.size() > 5 && name[0] == 'l' && isdigit(name[1]) &&
+           name.substr(name.size() - 4) == ".txt")
+            result.push_back(name);
+    }
+    closedir(dir);
+
+    sort(result.begin(), result.end());
+    return result;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int games = DEFAULT_GAMES;
+    uint64_t seed = 1;
+    int threads = 0;
+    int turn_limit = DEFAULT_TURN_LIMIT;
+    AIBehavior ally_behavior = PURSUE;
+    vector<string> level_names = {};
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "--games" && has_value)
+            games = stoi(argv[++i]);
+        else if(arg == "--seed" && has_value)
+            seed = stoull(argv[++i]);
+        else if(arg == "--threads" && has_value)
+            threads = stoi(argv[++i]);
+        else if(arg == "--turns" && has_value)
+            turn_limit = stoi(argv[++i]);
+        else if(arg == "--ally-behavior" && has_value)
+            ally_behavior = (AIBehavior)stoi(argv[++i]);
+        else if(arg[0] != '-')
+            level_names.push_back(arg);
+        else
+        {
+            cout << "usage: tournament [--games N] [--seed S] [--threads N] [--turns N]\n"
+                 << "                  [--ally-behavior B] [level.txt ...]\n";
+            return 1;
+        }
+    }
+
+    if(level_names.empty())
+        level_names = FindLevels();
+    if(level_names.empty())
+    {
+        cout << "ERROR tournament: No levels found in " << DATA_PATH << "\n";
+        return 1;
+    }
+
+    // Loading goes through the game's own code, so it stays on this thread.
+    LoadSounds();
+    vector<shared_ptr<Unit>> units = LoadUnits(DATA_PATH + string(INITIAL_UNITS));
+    vector<Level> levels = {};
+    for(const string &name : level_names)
+        levels.push_back(LoadLevel(name, units, {}));
+
+    GlobalJobs.Start(threads);
+    cout << "Playing " << games << " games of " << levels.size() << " levels, seed "
+         << seed << ", " << GlobalJobs.Size() << " threads.\n";
+
+    vector<GameResult> results(games);
+    WaitGroup running;
+    running.Add(games);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int i = 0; i < games; ++i)
+    {
+        GlobalJobs.Submit([&, i]()
+            {
+                int level_index = i % levels.size();
+                results[i] = PlayGame(levels[level_index], level_index, ally_behavior,
+                                      turn_limit, Mix64(seed + i));
+                running.Done();
+            });
+    }
+    running.Wait();
+    double wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    Report(results, level_names, wall_seconds, GlobalJobs.Size());
+
+    GlobalJobs.Stop();
+    UnloadSounds();
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Author: Alex Hartford
+// Program: Emblem
+// File: Transposition
+
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+// ============================ Transposition Table ============================
+// Remembers AI work by the board's Zobrist key. When a later unit, a later
+// turn, or a redo of the level comes back to the same board, the old answer is
+// handed back instead of searching again.
+//
+// Bounded: each key gets exactly one slot, and newer entries evict older ones.
+// NOTE: One set per thread, so headless tools can search from many at once.
+template <typename T>
+struct TranspositionTable
+{
+    struct Entry
+    {
+        uint64_t key = 0;
+        bool filled = false;
+        T value = {};
+    };
+
+    vector<Entry> entries;
+    int hits = 0;
+    int misses = 0;
+
+    TranspositionTable(int size)
+    : entries(size)
+    {
+        SDL_assert(size > 0 && !(size & (size - 1)));
+    }
+
+    bool
+    Find(uint64_t key, T *out)
+    {
+        const Entry &entry = entries[key & (entries.size() - 1)];
+        if(entry.filled && entry.key == key)
+        {
+            *out = entry.value;
+            ++hits;
+            return true;
+        }
+        ++misses;
+        return false;
+    }
+
+    void
+    Store(uint64_t key, const T &value)
+    {
+        Entry &entry = entries[key & (entries.size() - 1)];
+        entry.key = key;
+        entry.filled = true;
+        entry.value = value;
+    }
+
+    void
+    Clear()
+    {
+        for(Entry &entry : entries)
+            entry = {};
+        hits = 0;
+        misses = 0;
+    }
+};
+
+// What a unit decided to do. Positions only, so entries outlive the units.
+struct CachedAction
+{
+    position move;
+    position target; // {-1, -1} for no attack.
+};
+
+static thread_local TranspositionTable<pair<vector<position>, vector<position>>> GlobalMovementCache(TT_MOVEMENT_ENTRIES);
+static thread_local TranspositionTable<CachedAction> GlobalActionCache(TT_ACTION_ENTRIES);
+
+// AccessibleAndAttackableFrom, but only searched once per board.
+pair<vector<position>, vector<position>>
+CachedAccessibleAndAttackableFrom(const Tilemap &map, position origin,
+                                  int mov, int min, int max,
+                                  bool sourceIsAlly)
+{
+    uint64_t key = map.Hash() ^
+        Mix64(((uint64_t)(uint16_t)origin.col << 48) ^ ((uint64_t)(uint16_t)origin.row << 32) ^
+              ((uint64_t)(uint8_t)mov << 24) ^ ((uint64_t)(uint8_t)min << 16) ^
+              ((uint64_t)(uint8_t)max << 8) ^ (uint64_t)sourceIsAlly);
+
+    pair<vector<position>, vector<position>> result;
+    if(GlobalMovementCache.Find(key, &result))
+        return result;
+
+    result = AccessibleAndAttackableFrom(map, origin, mov, min, max, sourceIsAlly);
+    GlobalMovementCache.Store(key, result);
+    return result;
+}
+
+#endif
@@ -129,11 +129,50 @@ GetObjectiveString(Objective obj)
 	}
 }
 
+string
+GetBehaviorString(AIBehavior behavior)
+{
+    switch (behavior)
+    {
+    case NO_BEHAVIOR: return "None";
+    case PURSUE: return "Pursue";
+    case PURSUE_AFTER_1: return "Pursue after 1";
+    case PURSUE_AFTER_2: return "Pursue after 2";
+    case PURSUE_AFTER_3: return "Pursue after 3";
+    case BOSS: return "Boss";
+    case BOSS_THEN_MOVE: return "Boss then move";
+    case ATTACK_IN_RANGE: return "Attack in range";
+    case ATTACK_IN_TWO: return "Attack in two";
+    case FLEE: return "Flee";
+    case TREASURE_THEN_FLEE: return "Treasure then flee";
+	default:
+		assert(!"ERROR: Unhandled AIBehavior string in UI.\n");
+		return "";
+	}
+}
+
+string
+GetPhaseSpeedString(PhaseSpeed speed)
+{
+    switch (speed)
+    {
+    case PHASE_SPEED_1X: return "1x";
+    case PHASE_SPEED_2X: return "2x";
+    case PHASE_SPEED_4X: return "4x";
+    case PHASE_SPEED_8X: return "8x";
+    case PHASE_SPEED_INSTANT: return "Instant";
+	default:
+		assert(!"ERROR: Unhandled PhaseSpeed string in UI.\n");
+		return "";
+	}
+}
+
 // ============================ New UI =========================================
 struct UI_State
 {
     bool tile_info = false;
     bool outlook = false;
+    bool options = false;
     bool unit_blurb = false;
     bool unit_info = false;
     bool combat_preview = false;
@@ -148,6 +187,7 @@ struct UI_State
     {
         tile_info = false;
         outlook = false;
+        options = false;
         unit_blurb = false;
         unit_info = false;
         combat_preview = false;
@@ -213,6 +253,15 @@ struct UI_State
             outlook = false;
         }
 
+        if(GlobalInterfaceState == GAME_MENU_OPTIONS)
+        {
+            options = true;
+        }
+        else
+        {
+            options = false;
+        }
+
 		// Unit Blurb
 		if(
 				GlobalInterfaceState == NEUTRAL_OVER_ENEMY || 
@@ -316,6 +365,48 @@ DisplayOutlook(ImGuiWindowFlags wf, const Level &level)
     return;
 }
 
+void
+DisplayOptions(ImGuiWindowFlags wf)
+{
+	// Window sizing
+    ImGui::SetNextWindowPos(ImVec2(340, 200));
+    ImGui::SetNextWindowSize(ImVec2(360, 160));
+
+	ImGui::PushFont(uiFontLarge);
+    ImGui::Begin("Options", NULL, wf);
+    {
+		ImGui::PopFont();
+		ImGui::PushFont(uiFontMedium);
+			ImGui::Text("Enemy Phase - < %s >", GetPhaseSpeedString(GlobalPhaseSpeed).c_str());
+		ImGui::PopFont();
+    }
+    ImGui::End();
+
+    return;
+}
+
+// Summarizes an enemy phase that was resolved instantly.
+void
+DisplayCombatLog(ImGuiWindowFlags wf, const CombatLog &log)
+{
+	// Window sizing
+    ImGui::SetNextWindowPos(ImVec2(540, 10));
+    ImGui::SetNextWindowSize(ImVec2(480, 50 + 24 * log.lines.size()));
+
+	ImGui::PushFont(uiFontLarge);
+    ImGui::Begin("Combat Log", NULL, wf);
+    {
+		ImGui::PopFont();
+		ImGui::PushFont(uiFontSmall);
+            for(const string &line : log.lines)
+                ImGui::TextWrapped("%s", line.c_str());
+		ImGui::PopFont();
+    }
+    ImGui::End();
+
+    return;
+}
+
 void 
 DisplayTileInfo(ImGuiWindowFlags wf, const Tile &tile, enum quadrant quad)
 {
@@ -630,6 +721,7 @@ DisplayCombatPreview(ImGuiWindowFlags wf, const Unit &ally, const Unit &target,
 {
     // Predict the outcome
     Outcome outcome;
+    FightDistribution odds = {};
     if(target.is_ally)
     {
         outcome = PredictHealing(ally, target);
@@ -640,10 +732,11 @@ DisplayCombatPreview(ImGuiWindowFlags wf, const Unit &ally, const Unit &target,
                   ManhattanDistance(ally.pos, target.pos),
                   ally_avoid_bonus, enemy_avoid_bonus,
                   ally_defense_bonus, enemy_defense_bonus);
+        odds = DistributeFight(outcome, ally.health, target.health);
     }
 
 	// Window sizing
-    ImGui::SetNextWindowSize(ImVec2(350, 160));
+    ImGui::SetNextWindowSize(ImVec2(350, 190));
     ImGui::SetNextWindowPos(ImVec2(50, 400));
 
     // Render
@@ -661,11 +754,13 @@ DisplayCombatPreview(ImGuiWindowFlags wf, const Unit &ally, const Unit &target,
             }
             ImGui::Text("%d%% hit", outcome.one_hit);
             ImGui::Text("%d%% crit", outcome.one_crit);
+            if(!target.is_ally)
+                ImGui::Text("%d%% kill", (int)(odds.two_dies * 100 + 0.5));
         ImGui::PopFont();
     }
     ImGui::End();
 
-    ImGui::SetNextWindowSize(ImVec2(350, 160));
+    ImGui::SetNextWindowSize(ImVec2(350, 190));
     ImGui::SetNextWindowPos(ImVec2(510, 400));
 
     ImGui::Begin(target.name.c_str(), NULL, wf);
@@ -688,6 +783,9 @@ DisplayCombatPreview(ImGuiWindowFlags wf, const Unit &ally, const Unit &target,
                 ImGui::NewLine();
                 ImGui::SameLine(ImGui::GetWindowWidth()-150);
                 ImGui::Text("%d%% crit", outcome.two_crit);
+                ImGui::NewLine();
+                ImGui::SameLine(ImGui::GetWindowWidth()-150);
+                ImGui::Text("%d%% kill", (int)(odds.one_dies * 100 + 0.5));
             }
             else
             {
@@ -699,6 +797,9 @@ DisplayCombatPreview(ImGuiWindowFlags wf, const Unit &ally, const Unit &target,
                 ImGui::NewLine();
                 ImGui::SameLine(ImGui::GetWindowWidth()-150);
                 ImGui::Text("--%% crit");
+                ImGui::NewLine();
+                ImGui::SameLine(ImGui::GetWindowWidth()-150);
+                ImGui::Text("--%% kill");
             }
         ImGui::PopFont();
     }
@@ -851,7 +952,8 @@ RenderUI(UI_State *ui,
          const Cursor &cursor, 
          const Level &level,
          const Fight &fight,
-         const Parcel &parcel)
+         const Parcel &parcel,
+         const CombatLog &combat_log)
 {
     ui->Update();
 
@@ -896,6 +998,10 @@ RenderUI(UI_State *ui,
     // USER MODE UI
     if(ui->outlook)
         DisplayOutlook(window_flags, level);
+    if(ui->options)
+        DisplayOptions(window_flags);
+    if(combat_log.frames_left > 0)
+        DisplayCombatLog(window_flags, combat_log);
 	if(ui->tile_info)
 		DisplayTileInfo(window_flags, level.map.tiles[cursor.pos.col][cursor.pos.row], Quadrant(cursor.pos));
 	if(ui->unit_blurb)
@@ -5,45 +5,145 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <chrono>
 
-// Rolls a d100. range: 00 to 99.
+// splitmix64's finalizer | Scrambles a number into a well-spread 64-bit key.
+uint64_t
+Mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** | A small, fast generator for simulations.
+// Unlike rand(), each thread can own one, and a seed reproduces a run.
+struct Rng
+{
+    uint64_t state[4];
+
+    Rng(uint64_t seed = 0)
+    {
+        Seed(seed);
+    }
+
+    // Expands one number into the full state with splitmix64.
+    void
+    Seed(uint64_t seed)
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            seed += 0x9E3779B97F4A7C15ull;
+            state[i] = Mix64(seed);
+        }
+    }
+
+    uint64_t
+    Next()
+    {
+        uint64_t result = Rotate(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = Rotate(state[3], 45);
+
+        return result;
+    }
+
+    // Same range as d100. 00 to 99.
+    int
+    D100()
+    {
+        return (int)(((Next() >> 32) * 100) >> 32);
+    }
+
+private:
+    static uint64_t
+    Rotate(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// One Rng per RngStream, all seeded from a single number.
+// Each battle is seeded on its own, so any one of them can be played again.
+struct RngStreams
+{
+    uint64_t seed = 0;        // What the streams were last seeded with.
+    uint64_t next_battle = 0; // What the next battle will be seeded with.
+    Rng streams[RNG_STREAMS];
+
+    // Sets the seed of the first battle. The rest follow from it.
+    void
+    Begin(uint64_t first_battle)
+    {
+        next_battle = first_battle;
+        Seed(first_battle);
+    }
+
+    void
+    Seed(uint64_t seed_in)
+    {
+        seed = seed_in;
+        for(int i = 0; i < RNG_STREAMS; ++i)
+            streams[i].Seed(Mix64(seed ^ ((uint64_t)(i + 1) << 56)));
+    }
+
+    // Reseeds for a new battle. Returns the seed, to be recorded.
+    uint64_t
+    StartBattle()
+    {
+        uint64_t battle = next_battle;
+        next_battle = Mix64(next_battle + 1);
+        Seed(battle);
+        return battle;
+    }
+
+    Rng &
+    operator[](RngStream stream)
+    {
+        return streams[stream];
+    }
+};
+
+// NOTE: One per thread, so headless tools can each play their own games.
+static thread_local RngStreams GlobalRng;
+
+// Rolls a d100 from the given stream. range: 00 to 99.
 int
-d100()
+d100(RngStream stream)
 {
-    return rand() % 100;
+    return GlobalRng[stream].D100();
 }
 
+// Counts sim ticks, so it runs at the same rate however fast frames come,
+// and stops when the sim does.
 struct Timer
 {
-    Uint32 current = 0;
-    Uint32 last_frame = 0;
-    Uint32 end;
+    int current = 0;
+    int end = 0;
     bool paused = false;
 
     Timer(int seconds)
-    {
-        last_frame = SDL_GetTicks();
-        end = seconds * 1000;
-    }
+    : end(seconds * SIM_TICK_RATE)
+    {}
 
     Timer()
     {} // NOTE: This is c++ weirdness. I'm sure I could figure it out if I
        // gave it a few minutes.
 
+    // Once a tick.
     bool
     Update()
     {
         if(paused)
             return false;
 
-        int since_last_frame = SDL_GetTicks() - last_frame;
-
-        if(since_last_frame > 30) // Quick hack to fix pausing
-            since_last_frame = 30; // TODO: Really fix this someday
-
-        current += since_last_frame;
-
-        last_frame = SDL_GetTicks();
+        ++current;
         if(current >= end)
             return true;
         return false;
@@ -59,10 +159,96 @@ struct Timer
     Start()
     {
         paused = false;
-        last_frame = SDL_GetTicks();
     }
 };
 
+// ================================ Sim Clock ==================================
+// The game simulates in fixed ticks, SIM_TICK_RATE a second, apart from how
+// fast frames get drawn. Each frame, Advance() says how many ticks are owed
+// since the last one, and Alpha() how far the next tick along the frame is
+// drawn, so motion can be drawn in between.
+//
+// Also keeps a running average of what a tick and a frame cost.
+struct SimClock
+{
+    float speed = 1.0f;        // Sim seconds per real second.
+    double accumulator = 0.0;  // Real seconds not yet simulated.
+    bool started = false;
+    chrono::steady_clock::time_point last = {};
+
+    float sim_ms = 0.0f;       // Per tick.
+    float render_ms = 0.0f;    // Per frame.
+    chrono::steady_clock::time_point sim_start = {};
+    chrono::steady_clock::time_point render_start = {};
+
+    // How many ticks to run this frame.
+    int
+    Advance()
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if(!started)
+        {
+            started = true;
+            last = now;
+            return 1;
+        }
+        accumulator += chrono::duration<double>(now - last).count() * speed;
+        last = now;
+
+        double tick = 1.0 / SIM_TICK_RATE;
+        int ticks = (int)(accumulator / tick);
+
+        // After a stall (a breakpoint, a window drag), drop the time instead
+        // of running a burst of ticks to catch up.
+        if(ticks > SIM_MAX_TICKS_PER_FRAME)
+        {
+            ticks = SIM_MAX_TICKS_PER_FRAME;
+            accumulator = 0.0;
+        }
+        else
+        {
+            accumulator -= ticks * tick;
+        }
+        return ticks;
+    }
+
+    // 0 to 1. How far past the last tick this frame falls.
+    float
+    Alpha() const
+    {
+        return min(max((float)(accumulator * SIM_TICK_RATE), 0.0f), 1.0f);
+    }
+
+    void
+    BeginSim()
+    {
+        sim_start = chrono::steady_clock::now();
+    }
+
+    void
+    EndSim(int ticks)
+    {
+        if(ticks <= 0)
+            return;
+        float ms = chrono::duration<float, milli>(chrono::steady_clock::now() - sim_start).count();
+        sim_ms += (ms / ticks - sim_ms) * 0.05f;
+    }
+
+    void
+    BeginRender()
+    {
+        render_start = chrono::steady_clock::now();
+    }
+
+    void
+    EndRender()
+    {
+        float ms = chrono::duration<float, milli>(chrono::steady_clock::now() - render_start).count();
+        render_ms += (ms - render_ms) * 0.05f;
+    }
+};
+
+static SimClock GlobalClock;
 
 struct position
 {